@@ -9,12 +9,42 @@
 #include <linux/linkmode.h>
 #endif
 
-#if LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 10)
-typedef u32 pm_message_t;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#include <linux/sched/signal.h>
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+#include <linux/unaligned.h>
+#else
+#include <asm/unaligned.h>
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+#include <net/gso.h>
+#endif
+
+/* GSO types tx_fixup() segments itself, see aqc111_tx_gso() */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+#define AQ_SW_GSO
+#define AQ_SW_GSO_FEATURE	(NETIF_F_GSO_UDP_L4 |\
+				 NETIF_F_GSO_UDP_TUNNEL |\
+				 NETIF_F_GSO_UDP_TUNNEL_CSUM |\
+				 NETIF_F_GSO_GRE | NETIF_F_GSO_GRE_CSUM)
+#define AQ_SW_GSO_TYPES		(SKB_GSO_UDP_L4 |\
+				 SKB_GSO_UDP_TUNNEL |\
+				 SKB_GSO_UDP_TUNNEL_CSUM |\
+				 SKB_GSO_GRE | SKB_GSO_GRE_CSUM)
+#else
+#define AQ_SW_GSO_FEATURE	0
+#endif
+
+#if IS_ENABLED(CONFIG_HWMON) && LINUX_VERSION_CODE >= KERNEL_VERSION(3, 13, 0)
+#define AQ_HWMON
+#include <linux/hwmon.h>
 #endif
 
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 12, 0)
-#define usbnet_get_stats64 NULL
+#if LINUX_VERSION_CODE <= KERNEL_VERSION(2, 6, 10)
+typedef u32 pm_message_t;
 #endif
 
 #ifndef RHEL_RELEASE_VERSION
@@ -51,6 +81,10 @@ int usbnet_read_cmd_nopm(struct usbnet *dev, u8 cmd, u8 reqtype, u16 value,
 #define usbnet_set_skb_tx_stats(skb, packets, bytes_delta)
 #endif
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 0, 0)
+#define skb_vlan_tag_present(skb)	vlan_tx_tag_present(skb)
+#endif
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3, 10, 0) && !(RHEL_RELEASE_CODE)
 static inline void ether_addr_copy(u8 *dst, const u8 *src)
 {
@@ -15,11 +15,19 @@
 #include <linux/usb.h>
 #include <linux/crc32.h>
 #include <linux/if_vlan.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+#include <net/ipv6.h>
+#include <net/dsfield.h>
 #include <linux/usb/cdc.h>
 #include <linux/workqueue.h>
+#include <linux/pm_runtime.h>
 
 #include "aq_compat.h"
 #include "aqc111.h"
+#include "usbnet_ext.h"
 
 #define DRIVER_VERSION "1.3.3.0"
 #define DRIVER_NAME "aqc111"
@@ -275,7 +283,81 @@ static void aqc111_get_drvinfo(struct net_device *net,
 		 aqc111_data->fw_ver.minor,
 		 aqc111_data->fw_ver.rev);
 	info->eedump_len = 0x00;
-	info->regdump_len = 0x00;
+}
+
+static const struct {
+	u8 reg;
+	u8 len;
+} aqc111_regs_mac[] = {
+	{ SFR_RX_CTL, 2 },
+	{ SFR_MEDIUM_STATUS_MODE, 2 },
+	{ SFR_VLAN_ID_CONTROL, 1 },
+	{ SFR_RX_BULKIN_QCTRL, 5 },
+	{ SFR_RXCOE_CTL, 2 },
+	{ SFR_PAUSE_WATERLVL_LOW, 2 },
+};
+
+static const struct {
+	u16 mmd;
+	u16 reg;
+} aqc111_regs_phy[] = {
+	{ AQ_PHY_AUTONEG_ADDR, AQ_AUTONEG_STD_CTRL_REG },
+	{ AQ_PHY_AUTONEG_ADDR, AQ_AUTONEG_ADV_REG },
+	{ AQ_PHY_AUTONEG_ADDR, AQ_AUTONEG_10GT_CTRL_REG },
+	{ AQ_PHY_AUTONEG_ADDR, AQ_AUTONEG_VEN_PROV1_REG },
+	{ AQ_PHY_GLOBAL_ADDR, AQ_GLB_STD_CTRL_REG },
+	{ AQ_PHY_GLOBAL_ADDR, AQ_GLB_SYS_CFG_REG_5G },
+	{ AQ_PHY_GLOBAL_ADDR, AQ_GLB_ING_PAUSE_CTRL_REG },
+	{ AQ_PHY_GLOBAL_ADDR, AQ_GLB_EGR_PAUSE_CTRL_REG },
+	{ AQ_PHY_GLOBAL_ADDR, AQ_GLB_THERMAL_STAT1_REG },
+	{ AQ_PHY_GLOBAL_ADDR, AQ_GLB_THERMAL_STAT2_REG },
+};
+
+static int aqc111_get_regs_len(struct net_device *net)
+{
+	int len = sizeof(u32) + sizeof(aqc111_regs_phy);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(aqc111_regs_mac); i++)
+		len += aqc111_regs_mac[i].len;
+
+	return len;
+}
+
+static void aqc111_get_regs(struct net_device *net, struct ethtool_regs *regs,
+			    void *p)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u8 *buf = p;
+	u16 reg16;
+	int i;
+
+	memset(p, 0, regs->len);
+	regs->version = AQ_REGS_VERSION;
+
+	/* One control transfer per contiguous SFR block */
+	for (i = 0; i < ARRAY_SIZE(aqc111_regs_mac); i++) {
+		aqc111_read_cmd(dev, AQ_ACCESS_MAC, aqc111_regs_mac[i].reg,
+				aqc111_regs_mac[i].len,
+				aqc111_regs_mac[i].len, buf);
+		buf += aqc111_regs_mac[i].len;
+	}
+
+	put_unaligned_le32(aqc111_data->phy_cfg, buf);
+	buf += sizeof(u32);
+
+	/* The PHY belongs to the firmware unless accessed directly */
+	if (!aqc111_data->dpa)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(aqc111_regs_phy); i++) {
+		reg16 = 0;
+		aqc111_mdio_read(dev, aqc111_regs_phy[i].reg,
+				 aqc111_regs_phy[i].mmd, &reg16);
+		put_unaligned_le16(reg16, buf);
+		buf += sizeof(u16);
+	}
 }
 
 static void aqc111_get_wol(struct net_device *net,
@@ -310,6 +392,44 @@ static int aqc111_set_wol(struct net_device *net,
 static const char aqc111_priv_flag_names[][ETH_GSTRING_LEN] = {
 	"Low Power 5G",
 	"Thermal throttling",
+	"Autosuspend",
+	"Big TSO",
+};
+
+static const char aqc111_gstrings_stats[][ETH_GSTRING_LEN] = {
+	"rx_copy",
+	"rx_clone",
+	"rx_lro_merged",
+	"rx_lro_flushed",
+	"rx_csum_ok",
+	"rx_csum_err",
+	"rx_csum_none",
+	"rx_pd_drop",
+	"rx_wl_raise",
+	"rx_wl_lower",
+	"link_up_full",
+	"link_up_fast",
+	"link_up_last_us",
+	"link_up_max_us",
+	"link_down_last_us",
+	"link_down_max_us",
+	"resume_carrier_last_us",
+	"resume_carrier_max_us",
+	"pm_autosuspend",
+	"pm_autoresume",
+	"pm_wake_last_us",
+	"pm_wake_max_us",
+	"eee_rx_lpi_ms",
+	"eee_tx_lpi_ms",
+	"eee_wake_errors",
+	"tx_gso_sw",
+	"tx_gso_sw_segs",
+	/* struct usbnet_ext_stats */
+	"tx_urb_alloc",
+	"tx_urb_reuse",
+	"tx_queue_stop",
+	"rx_reserve_used",
+	"rx_alloc_failed",
 };
 
 static void aqc111_get_strings(struct net_device *net, u32 stringset, u8 *data)
@@ -319,9 +439,29 @@ static void aqc111_get_strings(struct net_device *net, u32 stringset, u8 *data)
 		memcpy(data, aqc111_priv_flag_names,
 		       sizeof(aqc111_priv_flag_names));
 		break;
+	case ETH_SS_STATS:
+		memcpy(data, aqc111_gstrings_stats,
+		       sizeof(aqc111_gstrings_stats));
+		break;
 	}
 }
 
+static void aqc111_get_ethtool_stats(struct net_device *net,
+				     struct ethtool_stats *stats, u64 *data)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct usbnet_ext_stats core;
+
+	BUILD_BUG_ON(ARRAY_SIZE(aqc111_gstrings_stats) * sizeof(u64) !=
+		     sizeof(struct aqc111_stats) +
+		     sizeof(struct usbnet_ext_stats));
+
+	usbnet_get_ext_stats(dev, &core);
+	memcpy(data, &aqc111_data->stats, sizeof(struct aqc111_stats));
+	memcpy((u8 *)data + sizeof(struct aqc111_stats), &core, sizeof(core));
+}
+
 static u32 aqc111_get_priv_flags(struct net_device *net)
 {
 	struct usbnet *dev = netdev_priv(net);
@@ -399,6 +539,24 @@ static void aqc111_set_phy_speed_direct(struct usbnet *dev,
 	aqc111_mdio_write(dev, AQ_AUTONEG_ADV_REG, AQ_PHY_AUTONEG_ADDR,
 			  &reg16_1);
 
+	/* EEE only at speeds that are advertised themselves */
+	reg16_1 = 0;
+	reg16_2 = 0;
+	if (aqc111_data->eee_enabled) {
+		u8 eee = aqc111_data->eee_adv & aqc111_data->phy_cfg;
+
+		if (eee & AQ_ADV_1G)
+			reg16_1 |= AQ_EEE_1G;
+		if (eee & AQ_ADV_2G5)
+			reg16_2 |= AQ_EEE2_2G5;
+		if (eee & AQ_ADV_5G)
+			reg16_2 |= AQ_EEE2_5G;
+	}
+	aqc111_mdio_write(dev, AQ_AUTONEG_EEE_ADV_REG, AQ_PHY_AUTONEG_ADDR,
+			  &reg16_1);
+	aqc111_mdio_write(dev, AQ_AUTONEG_EEE_ADV2_REG, AQ_PHY_AUTONEG_ADDR,
+			  &reg16_2);
+
 	/* Restart auto-negotiation */
 	reg16_1 = AQ_ANEG_EX_PAGE_CTRL | AQ_ANEG_EN_ANEG |
 		  AQ_ANEG_RESTART_ANEG;
@@ -407,54 +565,122 @@ static void aqc111_set_phy_speed_direct(struct usbnet *dev,
 			  AQ_PHY_AUTONEG_ADDR, &reg16_1);
 }
 
-static void aqc111_set_phy_speed(struct usbnet *dev, u8 autoneg, u16 speed)
+/* Speeds left to advertise at each driver throttling step */
+static const u32 aqc111_thermal_adv[AQ_THERMAL_STEPS + 1] = {
+	AQ_ADV_MASK,
+	AQ_ADV_MASK,
+	AQ_ADV_2G5 | AQ_ADV_1G | AQ_ADV_100M,
+	AQ_ADV_1G | AQ_ADV_100M,
+	AQ_ADV_100M,
+};
+
+/* Same encoding as mii_advertise_flowctrl() */
+static u32 aqc111_pause_adv(struct aqc111_data *aqc111_data)
+{
+	u32 adv = 0;
+
+	if (aqc111_data->rx_pause)
+		adv |= AQ_PAUSE | AQ_ASYM_PAUSE;
+	if (aqc111_data->tx_pause)
+		adv ^= AQ_ASYM_PAUSE;
+
+	return adv;
+}
+
+/* MEDIUM flow control bits for the current link. The firmware does not
+ * report the partner's pause ability, so without direct PHY access the
+ * forced rx/tx settings are applied as they are.
+ */
+static u16 aqc111_flow_ctrl(struct usbnet *dev)
 {
 	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u16 lcl = 0;
+	u16 rmt = 0;
+	u8 cap;
+
+	if (aqc111_data->pause_autoneg && aqc111_data->dpa &&
+	    aqc111_data->autoneg == AUTONEG_ENABLE) {
+		/* 7.0x10 and 7.0x13 share the clause 22 pause bit layout */
+		if (aqc111_data->phy_cfg & AQ_PAUSE)
+			lcl |= AQ_ANEG_PAUSE;
+		if (aqc111_data->phy_cfg & AQ_ASYM_PAUSE)
+			lcl |= AQ_ANEG_ASYM_PAUSE;
+		aqc111_mdio_read(dev, AQ_AUTONEG_LP_REG, AQ_PHY_AUTONEG_ADDR,
+				 &rmt);
+		rmt &= AQ_ANEG_PAUSE | AQ_ANEG_ASYM_PAUSE;
+		cap = mii_resolve_flowctrl_fdx(lcl, rmt);
+	} else {
+		cap = (aqc111_data->rx_pause ? FLOW_CTRL_RX : 0) |
+		      (aqc111_data->tx_pause ? FLOW_CTRL_TX : 0);
+	}
 
-	aqc111_data->phy_cfg &= ~AQ_ADV_MASK;
-	aqc111_data->phy_cfg |= AQ_PAUSE;
-	aqc111_data->phy_cfg |= AQ_ASYM_PAUSE;
-	aqc111_data->phy_cfg |= AQ_DOWNSHIFT;
-	aqc111_data->phy_cfg &= ~AQ_DSH_RETRIES_MASK;
-	aqc111_data->phy_cfg |= (3 << AQ_DSH_RETRIES_SHIFT) &
-				AQ_DSH_RETRIES_MASK;
+	return ((cap & FLOW_CTRL_RX) ? SFR_MEDIUM_RXFLOW_CTRLEN : 0) |
+	       ((cap & FLOW_CTRL_TX) ? SFR_MEDIUM_TXFLOW_CTRLEN : 0);
+}
+
+static u32 aqc111_phy_speed_cfg(struct aqc111_data *aqc111_data,
+				u8 autoneg, u16 speed)
+{
+	u32 phy_cfg = aqc111_data->phy_cfg;
+	u32 cap = aqc111_thermal_adv[aqc111_data->thermal_level];
 
-	aqc111_data->phy_cfg &= ~AQ_XFI_DIV_2;
-	if (aqc111_data->priv_flags & AQ_PF_XFI_DIV_2)
-		aqc111_data->phy_cfg |= AQ_XFI_DIV_2;
+	phy_cfg &= ~(AQ_ADV_MASK | AQ_PAUSE | AQ_ASYM_PAUSE);
+	phy_cfg |= aqc111_pause_adv(aqc111_data);
+	phy_cfg |= AQ_DOWNSHIFT;
+	phy_cfg &= ~AQ_DSH_RETRIES_MASK;
+	phy_cfg |= (3 << AQ_DSH_RETRIES_SHIFT) & AQ_DSH_RETRIES_MASK;
+
+	phy_cfg &= ~AQ_XFI_DIV_2;
+	if ((aqc111_data->priv_flags & AQ_PF_XFI_DIV_2) ||
+	    aqc111_data->thermal_level >= AQ_THERMAL_STEP_XFI_DIV_2)
+		phy_cfg |= AQ_XFI_DIV_2;
 
 	if (autoneg == AUTONEG_ENABLE) {
 		switch (speed) {
 		case SPEED_5000:
-			aqc111_data->phy_cfg |= AQ_ADV_5G;
+			phy_cfg |= AQ_ADV_5G;
 			/* fall-through */
 		case SPEED_2500:
-			aqc111_data->phy_cfg |= AQ_ADV_2G5;
+			phy_cfg |= AQ_ADV_2G5;
 			/* fall-through */
 		case SPEED_1000:
-			aqc111_data->phy_cfg |= AQ_ADV_1G;
+			phy_cfg |= AQ_ADV_1G;
 			/* fall-through */
 		case SPEED_100:
-			aqc111_data->phy_cfg |= AQ_ADV_100M;
+			phy_cfg |= AQ_ADV_100M;
 			/* fall-through */
 		}
 	} else {
 		switch (speed) {
 		case SPEED_5000:
-			aqc111_data->phy_cfg |= AQ_ADV_5G;
+			phy_cfg |= AQ_ADV_5G;
 			break;
 		case SPEED_2500:
-			aqc111_data->phy_cfg |= AQ_ADV_2G5;
+			phy_cfg |= AQ_ADV_2G5;
 			break;
 		case SPEED_1000:
-			aqc111_data->phy_cfg |= AQ_ADV_1G;
+			phy_cfg |= AQ_ADV_1G;
 			break;
 		case SPEED_100:
-			aqc111_data->phy_cfg |= AQ_ADV_100M;
+			phy_cfg |= AQ_ADV_100M;
 			break;
 		}
 	}
 
+	/* A forced speed above the thermal cap falls back to the cap */
+	if (!(phy_cfg & cap))
+		phy_cfg |= BIT(fls(cap) - 1);
+	phy_cfg &= ~AQ_ADV_MASK | cap;
+
+	return phy_cfg;
+}
+
+static void aqc111_set_phy_speed(struct usbnet *dev, u8 autoneg, u16 speed)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+
+	aqc111_data->phy_cfg = aqc111_phy_speed_cfg(aqc111_data, autoneg, speed);
+
 	if (aqc111_data->dpa)
 		aqc111_set_phy_speed_direct(dev, aqc111_data);
 	else
@@ -470,12 +696,445 @@ static int aqc111_update_thermal_params(struct usbnet *dev)
 	therm_params.threshold_critical = AQ_CRITICAL_TEMP_THRESHOLD;
 	therm_params.threshold_high = AQ_HIGH_TEMP_THRESHOLD;
 	therm_params.threshold_normal = AQ_NORMAL_TEMP_THRESHOLD;
-	therm_params.phy_speed_mask = AQ_ADV_100M;
+	/* The driver steps down before the firmware steps in, without
+	 * direct PHY access the firmware alone throttles, to 1G first
+	 */
+	therm_params.phy_speed_mask = aqc111_data->dpa ? AQ_ADV_100M :
+					AQ_ADV_1G | AQ_ADV_100M;
 	return aqc111_write_cmd(dev, AQ_PHY_THERMAL, 0, 0,
 				sizeof(struct aqc111_thermal_params),
 				&therm_params);
 }
 
+/* Bulk-in aggregation depends on link speed, USB speed and MTU */
+static void aqc111_set_bulkin(struct usbnet *dev,
+			      struct aqc111_data *aqc111_data)
+{
+	u8 queue_num = 0;
+	u8 buf[5];
+
+	if (aqc111_data->link_speed == AQ_INT_SPEED_100M)
+		queue_num = 1;
+
+	if (dev->udev->speed == USB_SPEED_FULL ||
+	    dev->udev->speed == USB_SPEED_LOW)
+		queue_num = 0;
+
+	if (dev->net->mtu > 12500 && dev->net->mtu <= 16334)
+		queue_num = 2; /* For Jumbo packet 16KB */
+
+	memcpy(buf, &AQC111_BULKIN_SIZE[queue_num], 5);
+	/* RX bulk configuration */
+	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_RX_BULKIN_QCTRL, 5, 5, buf);
+}
+
+static u8 aqc111_scale_water_level(u8 level, u8 scale)
+{
+	return clamp_t(u32, level * scale / AQ_WL_SCALE_BASE, 1, 0xFF);
+}
+
+static void aqc111_set_water_level(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u8 scale = aqc111_data->wl.scale;
+	u16 reg16 = 0;
+
+	/* Set high low water level */
+	if (dev->net->mtu <= 4500)
+		reg16 = 0x0810;
+	else if (dev->net->mtu <= 9500)
+		reg16 = 0x1020;
+	else if (dev->net->mtu <= 12500)
+		reg16 = 0x1420;
+	else if (dev->net->mtu <= 16334)
+		reg16 = 0x1A20;
+
+	/* Larger levels leave more FIFO room, i.e. PAUSE is sent earlier */
+	reg16 = aqc111_scale_water_level(reg16 >> 8, scale) << 8 |
+		aqc111_scale_water_level(reg16 & 0xFF, scale);
+
+	aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_PAUSE_WATERLVL_LOW,
+			   2, &reg16);
+}
+
+/* Pause earlier while the host falls behind, later while it keeps up */
+static void aqc111_update_water_level(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u64 drops = aqc111_data->stats.rx_pd_drop - aqc111_data->wl.drops;
+	u32 backlog = aqc111_data->wl.backlog;
+	u8 scale = aqc111_data->wl.scale;
+
+	aqc111_data->wl.drops = aqc111_data->stats.rx_pd_drop;
+	aqc111_data->wl.backlog = 0;
+
+	if (!aqc111_data->link)
+		return;
+
+	if (drops || backlog >= AQ_WL_BACKLOG_HIGH) {
+		aqc111_data->wl.calm = 0;
+		scale = min_t(u8, scale + 2, AQ_WL_SCALE_MAX);
+	} else if (backlog <= AQ_WL_BACKLOG_LOW) {
+		if (++aqc111_data->wl.calm >= AQ_WL_CALM_POLLS) {
+			aqc111_data->wl.calm = 0;
+			scale = max_t(u8, scale - 1, AQ_WL_SCALE_MIN);
+		}
+	} else {
+		aqc111_data->wl.calm = 0;
+	}
+
+	if (scale == aqc111_data->wl.scale)
+		return;
+
+	if (scale > aqc111_data->wl.scale)
+		aqc111_data->stats.rx_wl_raise++;
+	else
+		aqc111_data->stats.rx_wl_lower++;
+	aqc111_data->wl.scale = scale;
+	aqc111_set_water_level(dev);
+}
+
+static int aqc111_read_temp(struct usbnet *dev, int *temp)
+{
+	u16 reg16 = 0;
+	int ret;
+
+	ret = aqc111_read16_cmd_nopm(dev, AQ_PHY_CMD, AQ_GLB_THERMAL_STAT2_REG,
+				     AQ_PHY_GLOBAL_ADDR, &reg16);
+	if (ret < 0)
+		return ret;
+	if (!(reg16 & AQ_THERMAL_READY))
+		return -EAGAIN;
+
+	ret = aqc111_read16_cmd_nopm(dev, AQ_PHY_CMD, AQ_GLB_THERMAL_STAT1_REG,
+				     AQ_PHY_GLOBAL_ADDR, &reg16);
+	if (ret < 0)
+		return ret;
+
+	/* two's complement, 1/256 degree Celsius */
+	*temp = (s16)reg16 * 1000 / 256;
+
+	return 0;
+}
+
+static void aqc111_set_thermal_level(struct usbnet *dev, u8 level)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u32 phy_cfg;
+
+	if (level == aqc111_data->thermal_level)
+		return;
+
+	netdev_info(dev->net, "Thermal step %u -> %u at %d mC\n",
+		    aqc111_data->thermal_level, level, aqc111_data->temp);
+	if (!aqc111_data->thermal_level)
+		aqc111_data->thermal_events++;
+	aqc111_data->thermal_level = level;
+	/* Renegotiation idles the link, start measuring afresh */
+	aqc111_data->gov.busy_ms = 0;
+	aqc111_data->gov.idle_ms = 0;
+
+	if ((aqc111_data->phy_cfg & AQ_LOW_POWER) ||
+	    !(aqc111_data->phy_cfg & AQ_PHY_POWER_EN))
+		return;
+
+	/* Renegotiate only if the advertisement actually changes */
+	phy_cfg = aqc111_phy_speed_cfg(aqc111_data, aqc111_data->autoneg,
+				       aqc111_data->advertised_speed);
+	if (phy_cfg != aqc111_data->phy_cfg)
+		aqc111_set_phy_speed(dev, aqc111_data->autoneg,
+				     aqc111_data->advertised_speed);
+}
+
+static u32 aqc111_link_mbps(struct aqc111_data *aqc111_data)
+{
+	if (!aqc111_data->link)
+		return 0;
+
+	switch (aqc111_data->link_speed) {
+	case AQ_INT_SPEED_5G:
+		return 5000;
+	case AQ_INT_SPEED_2_5G:
+		return 2500;
+	case AQ_INT_SPEED_1G:
+		return 1000;
+	case AQ_INT_SPEED_100M:
+		return 100;
+	}
+
+	return 0;
+}
+
+/* Mbit/s times us gives bits */
+static void aqc111_set_tx_bulk_limit(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u32 bytes = aqc111_link_mbps(aqc111_data) * AQ_TX_BULK_US / 8;
+
+	usbnet_set_tx_band_limit(dev, AQ_TX_BAND_BULK,
+				 max_t(u32, bytes, AQ_TX_BULK_MIN));
+}
+
+/* Sampled once per poll, so the residency is an estimate */
+static void aqc111_update_lpi(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct aqc111_stats *stats = &aqc111_data->stats;
+	u16 reg16 = 0;
+
+	if (!aqc111_data->dpa || !aqc111_data->eee_enabled ||
+	    !aqc111_data->link)
+		return;
+
+	if (aqc111_read16_cmd_nopm(dev, AQ_PHY_CMD, AQ_PCS_STAT1_REG,
+				   AQ_PHY_PCS_ADDR, &reg16) < 0)
+		return;
+
+	if (reg16 & AQ_PCS_RX_LPI)
+		stats->eee_rx_lpi_ms += aqc111_data->thermal_interval;
+	if (reg16 & AQ_PCS_TX_LPI)
+		stats->eee_tx_lpi_ms += aqc111_data->thermal_interval;
+
+	/* Clears on read */
+	if (aqc111_read16_cmd_nopm(dev, AQ_PHY_CMD, AQ_PCS_EEE_WAKE_ERR_REG,
+				   AQ_PHY_PCS_ADDR, &reg16) < 0)
+		return;
+
+	stats->eee_wake_errors += reg16;
+}
+
+/* Load of the busier direction since the last poll, in percent of the
+ * link speed, and how long it has stayed busy or idle.
+ */
+static void aqc111_gov_update_load(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct rtnl_link_stats64 storage;
+	const struct rtnl_link_stats64 *stats;
+	u32 mbps = aqc111_link_mbps(aqc111_data);
+	u64 bytes, load;
+	u32 elapsed;
+
+	stats = dev_get_stats(dev->net, &storage);
+	bytes = max(stats->rx_bytes - aqc111_data->gov.rx_bytes,
+		    stats->tx_bytes - aqc111_data->gov.tx_bytes);
+	elapsed = jiffies_to_msecs(jiffies - aqc111_data->gov.stamp);
+
+	aqc111_data->gov.rx_bytes = stats->rx_bytes;
+	aqc111_data->gov.tx_bytes = stats->tx_bytes;
+	aqc111_data->gov.stamp = jiffies;
+
+	if (!mbps || !elapsed) {
+		aqc111_data->gov.load = 0;
+	} else {
+		/* Mbit/s * ms * 1000 = bit */
+		load = div64_u64(bytes * 8 * 100, (u64)mbps * elapsed * 1000);
+		aqc111_data->gov.load = min_t(u64, load, 100);
+	}
+
+	if (aqc111_data->gov.load >= aqc111_data->gov.busy_load) {
+		aqc111_data->gov.busy_ms = min_t(u32, aqc111_data->gov.busy_ms +
+						 elapsed, AQ_GOV_MAX_SUSTAIN_MS);
+		aqc111_data->gov.idle_ms = 0;
+	} else if (aqc111_data->gov.load < aqc111_data->gov.idle_load) {
+		aqc111_data->gov.idle_ms = min_t(u32, aqc111_data->gov.idle_ms +
+						 elapsed, AQ_GOV_MAX_SUSTAIN_MS);
+		aqc111_data->gov.busy_ms = 0;
+	} else {
+		aqc111_data->gov.busy_ms = 0;
+		aqc111_data->gov.idle_ms = 0;
+	}
+}
+
+/* One step at a time. A step is taken once its temperature is reached
+ * under sustained load, and released once the chip has cooled down by
+ * the hysteresis or the link has gone idle below the step temperature.
+ * The 100M step is an emergency and only follows the temperature.
+ */
+static u8 aqc111_thermal_next_level(struct aqc111_data *aqc111_data)
+{
+	bool busy = aqc111_data->gov.busy_ms >= aqc111_data->gov.sustain_ms;
+	bool idle = aqc111_data->gov.idle_ms >= aqc111_data->gov.sustain_ms;
+	u8 *step = aqc111_data->thermal_step;
+	u8 level = aqc111_data->thermal_level;
+	int temp = aqc111_data->temp;
+
+	if (temp >= step[AQ_THERMAL_STEP_100M - 1] * 1000)
+		return AQ_THERMAL_STEP_100M;
+	if (level < AQ_THERMAL_STEPS && busy &&
+	    temp >= step[level] * 1000)
+		return level + 1;
+	if (level > 0 &&
+	    (temp < (step[level - 1] - aqc111_data->thermal_hyst) * 1000 ||
+	     (idle && temp < step[level - 1] * 1000)))
+		return level - 1;
+
+	return level;
+}
+
+static void aqc111_thermal_work(struct work_struct *work)
+{
+	struct aqc111_data *aqc111_data = container_of(work,
+						       struct aqc111_data,
+						       thermal_work.work);
+	struct usbnet *dev = aqc111_data->dev;
+
+	/* ethtool and stop() hold rtnl, the latter while cancelling us */
+	if (!rtnl_trylock())
+		goto out;
+
+	aqc111_gov_update_load(dev);
+
+	/* Poll without waking the device or delaying its autosuspend */
+	usb_autopm_get_interface_no_resume(dev->intf);
+	if (test_bit(EVENT_DEV_ASLEEP, &dev->flags)) {
+		aqc111_data->temp_valid = false;
+		goto put;
+	}
+
+	aqc111_update_water_level(dev);
+	aqc111_update_lpi(dev);
+	/* The PHY belongs to the firmware unless accessed directly */
+	aqc111_data->temp_valid = aqc111_data->dpa &&
+				  !aqc111_read_temp(dev, &aqc111_data->temp);
+	if (aqc111_data->temp_valid &&
+	    (aqc111_data->priv_flags & AQ_PF_THERMAL))
+		aqc111_set_thermal_level(dev,
+					 aqc111_thermal_next_level(aqc111_data));
+put:
+	usb_autopm_put_interface_no_suspend(dev->intf);
+
+	rtnl_unlock();
+out:
+	queue_delayed_work(system_freezable_wq, &aqc111_data->thermal_work,
+			   msecs_to_jiffies(aqc111_data->thermal_interval));
+}
+
+/* The temperature is polled while the interface is up and the PHY is
+ * accessed directly, stepping is done only with thermal throttling
+ * enabled. Otherwise only the firmware throttles.
+ */
+static void aqc111_thermal_start(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct rtnl_link_stats64 storage;
+	const struct rtnl_link_stats64 *stats;
+
+	stats = dev_get_stats(dev->net, &storage);
+	aqc111_data->gov.rx_bytes = stats->rx_bytes;
+	aqc111_data->gov.tx_bytes = stats->tx_bytes;
+	aqc111_data->gov.stamp = jiffies;
+	aqc111_data->gov.busy_ms = 0;
+	aqc111_data->gov.idle_ms = 0;
+	queue_delayed_work(system_freezable_wq, &aqc111_data->thermal_work, 0);
+}
+
+static void aqc111_thermal_stop(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+
+	cancel_delayed_work_sync(&aqc111_data->thermal_work);
+	aqc111_data->temp_valid = false;
+}
+
+static void aqc111_phy_power_up(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u16 reg16 = 0;
+	u8 reg8 = 0;
+
+	if (aqc111_data->dpa) {
+		aqc111_read_cmd(dev, AQ_PHY_POWER, 0, 0, 1, &reg8);
+		if (reg8 == 0x00) {
+			reg8 = 0x02;
+			aqc111_write_cmd(dev, AQ_PHY_POWER, 0, 0, 1, &reg8);
+			msleep(200);
+		}
+
+		aqc111_mdio_read(dev, AQ_GLB_STD_CTRL_REG, AQ_PHY_GLOBAL_ADDR,
+				 &reg16);
+		if (reg16 & AQ_PHY_LOW_POWER_MODE) {
+			reg16 &= ~AQ_PHY_LOW_POWER_MODE;
+			aqc111_mdio_write(dev, AQ_GLB_STD_CTRL_REG,
+					  AQ_PHY_GLOBAL_ADDR, &reg16);
+		}
+	} else {
+		aqc111_write32_cmd(dev, AQ_PHY_OPS, 0, 0,
+				   &aqc111_data->phy_cfg);
+	}
+}
+
+/* PHY power up and autoneg restart after resume, off the resume path */
+static void aqc111_phy_work(struct work_struct *work)
+{
+	struct aqc111_data *aqc111_data = container_of(work,
+						       struct aqc111_data,
+						       phy_work.work);
+	struct usbnet *dev = aqc111_data->dev;
+
+	/* Serialize with ethtool and the thermal steps */
+	if (!rtnl_trylock()) {
+		schedule_delayed_work(&aqc111_data->phy_work,
+				      msecs_to_jiffies(AQ_PHY_WORK_RETRY_MS));
+		return;
+	}
+
+	/* stop() left the PHY in low power, keep it there */
+	if (netif_running(dev->net)) {
+		aqc111_phy_power_up(dev);
+		aqc111_set_phy_speed(dev, aqc111_data->autoneg,
+				     aqc111_data->advertised_speed);
+	}
+
+	rtnl_unlock();
+	usb_autopm_put_interface(dev->intf);
+}
+
+/* Drop the PM reference of a PHY work that will not run anymore */
+static void aqc111_phy_work_cancel(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+
+	if (cancel_delayed_work_sync(&aqc111_data->phy_work))
+		usb_autopm_put_interface_no_suspend(dev->intf);
+}
+
+static void aqc111_pm_hold(struct usbnet *dev, bool hold)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+
+	if (aqc111_data->pm_hold == hold)
+		return;
+
+	aqc111_data->pm_hold = hold;
+	if (hold)
+		usb_autopm_get_interface(dev->intf);
+	else
+		usb_autopm_put_interface(dev->intf);
+}
+
+/* Called by usbnet on open and stop. The device only autosuspends while
+ * open when the private flag allows it.
+ */
+static int aqc111_manage_power(struct usbnet *dev, int on)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+
+	aqc111_data->pm_managed = on;
+	dev->intf->needs_remote_wakeup = on;
+	aqc111_pm_hold(dev, on && !(aqc111_data->priv_flags &
+				    AQ_PF_AUTOSUSPEND));
+
+	return 0;
+}
+
+static void aqc111_enable_autosuspend(struct usbnet *dev)
+{
+	pm_runtime_set_autosuspend_delay(&dev->udev->dev,
+					 AQ_AUTOSUSPEND_DELAY_MS);
+	usb_enable_autosuspend(dev->udev);
+}
+
 static int aqc111_set_priv_flags(struct net_device *net, u32 flags)
 {
 	struct usbnet *dev = netdev_priv(net);
@@ -485,6 +1144,19 @@ static int aqc111_set_priv_flags(struct net_device *net, u32 flags)
 	if (flags & ~AQ_PRIV_FLAGS_MASK)
 		return -EOPNOTSUPP;
 
+	/* Without the link change wake every autoresume renegotiates */
+	if ((flags & AQ_PF_AUTOSUSPEND) && !aqc111_data->dpa)
+		return -EOPNOTSUPP;
+
+	/* Frames beyond 64KB stay paged only with SG TX */
+#if KERNEL_VERSION(6, 3, 0) <= LINUX_VERSION_CODE
+	if ((flags & AQ_PF_BIG_TSO) && !usbnet_can_dma_sg(dev))
+		return -EOPNOTSUPP;
+#else
+	if (flags & AQ_PF_BIG_TSO)
+		return -EOPNOTSUPP;
+#endif
+
 	changed = aqc111_data->priv_flags^flags;
 	aqc111_data->priv_flags = flags;
 
@@ -495,8 +1167,25 @@ static int aqc111_set_priv_flags(struct net_device *net, u32 flags)
 					     aqc111_data->advertised_speed);
 		}
 	}
-	if (changed & AQ_PF_THERMAL)
+	if (changed & AQ_PF_THERMAL) {
 		aqc111_update_thermal_params(dev);
+		if (!(flags & AQ_PF_THERMAL))
+			aqc111_set_thermal_level(dev, 0);
+	}
+	if (changed & AQ_PF_AUTOSUSPEND) {
+		if (flags & AQ_PF_AUTOSUSPEND)
+			aqc111_enable_autosuspend(dev);
+		else
+			usb_disable_autosuspend(dev->udev);
+		if (aqc111_data->pm_managed)
+			aqc111_pm_hold(dev, !(flags & AQ_PF_AUTOSUSPEND));
+	}
+#if KERNEL_VERSION(6, 3, 0) <= LINUX_VERSION_CODE
+	/* Lowering it clamps gso_ipv4_max_size as well */
+	if (changed & AQ_PF_BIG_TSO)
+		netif_set_tso_max_size(net, (flags & AQ_PF_BIG_TSO) ?
+				       AQ_TSO_MAX_SIZE : AQ_TSO_LEGACY_SIZE);
+#endif
 
 	return 0;
 }
@@ -509,6 +1198,9 @@ static int aqc111_get_sset_count(struct net_device *net, int stringset)
 	case ETH_SS_PRIV_FLAGS:
 		ret = ARRAY_SIZE(aqc111_priv_flag_names);
 		break;
+	case ETH_SS_STATS:
+		ret = ARRAY_SIZE(aqc111_gstrings_stats);
+		break;
 	default:
 		ret = -EOPNOTSUPP;
 	}
@@ -655,12 +1347,271 @@ static int aqc111_set_settings(struct net_device *net, struct ethtool_cmd *cmd)
 	return 0;
 }
 
+#if KERNEL_VERSION(6, 9, 0) <= LINUX_VERSION_CODE
+/* ethtool_keee carries link mode masks, every speed has its own bit */
+static void aqc111_eee_to_ethtool(u8 eee, unsigned long *modes)
+{
+	linkmode_zero(modes);
+	if (eee & AQ_ADV_1G)
+		linkmode_set_bit(ETHTOOL_LINK_MODE_1000baseT_Full_BIT, modes);
+	if (eee & AQ_ADV_2G5)
+		linkmode_set_bit(ETHTOOL_LINK_MODE_2500baseT_Full_BIT, modes);
+	if (eee & AQ_ADV_5G)
+		linkmode_set_bit(ETHTOOL_LINK_MODE_5000baseT_Full_BIT, modes);
+}
+
+static u8 aqc111_ethtool_to_eee(const unsigned long *modes)
+{
+	u8 eee = 0;
+
+	if (linkmode_test_bit(ETHTOOL_LINK_MODE_1000baseT_Full_BIT, modes))
+		eee |= AQ_ADV_1G;
+	if (linkmode_test_bit(ETHTOOL_LINK_MODE_2500baseT_Full_BIT, modes))
+		eee |= AQ_ADV_2G5;
+	if (linkmode_test_bit(ETHTOOL_LINK_MODE_5000baseT_Full_BIT, modes))
+		eee |= AQ_ADV_5G;
+
+	return eee;
+}
+#else
+/* There is no legacy ethtool bit for 5GBASE-T, it follows 2.5G */
+static u32 aqc111_eee_to_ethtool(u8 eee)
+{
+	u32 adv = 0;
+
+	if (eee & AQ_ADV_1G)
+		adv |= ADVERTISED_1000baseT_Full;
+	if (eee & (AQ_ADV_2G5 | AQ_ADV_5G))
+		adv |= ADVERTISED_2500baseX_Full;
+
+	return adv;
+}
+
+static u8 aqc111_ethtool_to_eee(u32 adv)
+{
+	u8 eee = 0;
+
+	if (adv & ADVERTISED_1000baseT_Full)
+		eee |= AQ_ADV_1G;
+	if (adv & ADVERTISED_2500baseX_Full)
+		eee |= AQ_ADV_2G5 | AQ_ADV_5G;
+
+	return eee;
+}
+#endif
+
+static u8 aqc111_eee_lp(struct usbnet *dev)
+{
+	u16 reg16 = 0;
+	u8 eee = 0;
+
+	aqc111_mdio_read(dev, AQ_AUTONEG_EEE_LP_REG, AQ_PHY_AUTONEG_ADDR,
+			 &reg16);
+	if (reg16 & AQ_EEE_1G)
+		eee |= AQ_ADV_1G;
+
+	reg16 = 0;
+	aqc111_mdio_read(dev, AQ_AUTONEG_EEE_LP2_REG, AQ_PHY_AUTONEG_ADDR,
+			 &reg16);
+	if (reg16 & AQ_EEE2_2G5)
+		eee |= AQ_ADV_2G5;
+	if (reg16 & AQ_EEE2_5G)
+		eee |= AQ_ADV_5G;
+
+	return eee;
+}
+
+/* EEE is only reachable with direct PHY access, the firmware interface
+ * has no EEE control. LPI is entered by the PHY on its own, so there is
+ * no MAC side LPI timer.
+ */
+#if KERNEL_VERSION(6, 9, 0) <= LINUX_VERSION_CODE
+static int aqc111_get_eee(struct net_device *net, struct ethtool_keee *edata)
+#else
+static int aqc111_get_eee(struct net_device *net, struct ethtool_eee *edata)
+#endif
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u8 link_adv = 0;
+	u8 lp;
+
+	if (!aqc111_data->dpa)
+		return -EOPNOTSUPP;
+
+	switch (aqc111_link_mbps(aqc111_data)) {
+	case 5000:
+		link_adv = AQ_ADV_5G;
+		break;
+	case 2500:
+		link_adv = AQ_ADV_2G5;
+		break;
+	case 1000:
+		link_adv = AQ_ADV_1G;
+		break;
+	}
+
+	lp = aqc111_eee_lp(dev);
+#if KERNEL_VERSION(6, 9, 0) <= LINUX_VERSION_CODE
+	aqc111_eee_to_ethtool(AQ_EEE_SUPPORTED, edata->supported);
+	aqc111_eee_to_ethtool(aqc111_data->eee_enabled ?
+			      aqc111_data->eee_adv : 0, edata->advertised);
+	aqc111_eee_to_ethtool(lp, edata->lp_advertised);
+#else
+	edata->supported = aqc111_eee_to_ethtool(AQ_EEE_SUPPORTED);
+	edata->advertised = aqc111_data->eee_enabled ?
+			    aqc111_eee_to_ethtool(aqc111_data->eee_adv) : 0;
+	edata->lp_advertised = aqc111_eee_to_ethtool(lp);
+#endif
+	edata->eee_enabled = aqc111_data->eee_enabled;
+	edata->eee_active = aqc111_data->eee_enabled &&
+			    (aqc111_data->eee_adv & lp & link_adv);
+	edata->tx_lpi_enabled = aqc111_data->eee_enabled;
+	edata->tx_lpi_timer = 0;
+
+	return 0;
+}
+
+#if KERNEL_VERSION(6, 9, 0) <= LINUX_VERSION_CODE
+static int aqc111_set_eee(struct net_device *net, struct ethtool_keee *edata)
+#else
+static int aqc111_set_eee(struct net_device *net, struct ethtool_eee *edata)
+#endif
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+#if KERNEL_VERSION(6, 9, 0) <= LINUX_VERSION_CODE
+	__ETHTOOL_DECLARE_LINK_MODE_MASK(unsupported);
+#endif
+	u8 eee;
+
+	if (!aqc111_data->dpa)
+		return -EOPNOTSUPP;
+
+	if (edata->tx_lpi_timer)
+		return -EINVAL;
+
+#if KERNEL_VERSION(6, 9, 0) <= LINUX_VERSION_CODE
+	aqc111_eee_to_ethtool(AQ_EEE_SUPPORTED, unsupported);
+	if (linkmode_andnot(unsupported, edata->advertised, unsupported))
+		return -EINVAL;
+#else
+	if (edata->advertised & ~aqc111_eee_to_ethtool(AQ_EEE_SUPPORTED))
+		return -EINVAL;
+#endif
+
+	eee = aqc111_ethtool_to_eee(edata->advertised);
+	aqc111_data->eee_adv = eee ? eee : AQ_EEE_SUPPORTED;
+	aqc111_data->eee_enabled = edata->eee_enabled;
+
+	if (!(aqc111_data->phy_cfg & AQ_LOW_POWER) &&
+	    (aqc111_data->phy_cfg & AQ_PHY_POWER_EN))
+		aqc111_set_phy_speed(dev, aqc111_data->autoneg,
+				     aqc111_data->advertised_speed);
+
+	return 0;
+}
+
+static void aqc111_get_pauseparam(struct net_device *net,
+				  struct ethtool_pauseparam *pause)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+
+	pause->autoneg = aqc111_data->pause_autoneg;
+	pause->rx_pause = aqc111_data->rx_pause;
+	pause->tx_pause = aqc111_data->tx_pause;
+}
+
+/* The advertisement follows rx/tx in both modes, a change of it
+ * restarts autonegotiation and link_reset applies the result. Otherwise
+ * only the MAC side is updated on a live link.
+ */
+static int aqc111_set_pauseparam(struct net_device *net,
+				 struct ethtool_pauseparam *pause)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u32 adv = aqc111_pause_adv(aqc111_data);
+	u16 reg16 = 0;
+
+	if (pause->autoneg && aqc111_data->autoneg != AUTONEG_ENABLE)
+		return -EINVAL;
+
+	aqc111_data->pause_autoneg = pause->autoneg;
+	aqc111_data->rx_pause = pause->rx_pause;
+	aqc111_data->tx_pause = pause->tx_pause;
+
+	if (!(aqc111_data->phy_cfg & AQ_LOW_POWER) &&
+	    (aqc111_data->phy_cfg & AQ_PHY_POWER_EN) &&
+	    adv != aqc111_pause_adv(aqc111_data)) {
+		aqc111_set_phy_speed(dev, aqc111_data->autoneg,
+				     aqc111_data->advertised_speed);
+		return 0;
+	}
+
+	if (aqc111_data->link) {
+		aqc111_read16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
+				  2, &reg16);
+		reg16 &= ~(SFR_MEDIUM_RXFLOW_CTRLEN |
+			   SFR_MEDIUM_TXFLOW_CTRLEN);
+		reg16 |= aqc111_flow_ctrl(dev);
+		aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
+				   2, &reg16);
+	}
+
+	return 0;
+}
+
+#if KERNEL_VERSION(3, 18, 0) <= LINUX_VERSION_CODE
+static int aqc111_get_tunable(struct net_device *net,
+			      const struct ethtool_tunable *tuna, void *data)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		*(u32 *)data = aqc111_data->rx_copybreak;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int aqc111_set_tunable(struct net_device *net,
+			      const struct ethtool_tunable *tuna,
+			      const void *data)
+{
+	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	u32 val;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		val = *(u32 *)data;
+		if (val > AQ_RX_COPYBREAK_MAX)
+			return -EINVAL;
+		aqc111_data->rx_copybreak = val;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+#endif
+
 static const struct ethtool_ops aqc111_ethtool_ops = {
 #if KERNEL_VERSION(4, 6, 0) > LINUX_VERSION_CODE
 	.get_settings = aqc111_get_settings,
 	.set_settings = aqc111_set_settings,
 #endif
 	.get_drvinfo = aqc111_get_drvinfo,
+	.get_regs_len = aqc111_get_regs_len,
+	.get_regs = aqc111_get_regs,
 	.get_wol = aqc111_get_wol,
 	.set_wol = aqc111_set_wol,
 	.get_msglevel = usbnet_get_msglevel,
@@ -670,6 +1621,15 @@ static const struct ethtool_ops aqc111_ethtool_ops = {
 	.get_priv_flags = aqc111_get_priv_flags,
 	.set_priv_flags = aqc111_set_priv_flags,
 	.get_sset_count = aqc111_get_sset_count,
+	.get_ethtool_stats = aqc111_get_ethtool_stats,
+	.get_eee = aqc111_get_eee,
+	.set_eee = aqc111_set_eee,
+	.get_pauseparam = aqc111_get_pauseparam,
+	.set_pauseparam = aqc111_set_pauseparam,
+#if KERNEL_VERSION(3, 18, 0) <= LINUX_VERSION_CODE
+	.get_tunable = aqc111_get_tunable,
+	.set_tunable = aqc111_set_tunable,
+#endif
 #if KERNEL_VERSION(4, 6, 0) <= LINUX_VERSION_CODE
 	.get_link_ksettings = aqc111_get_link_ksettings,
 	.set_link_ksettings = aqc111_set_link_ksettings
@@ -679,8 +1639,8 @@ static const struct ethtool_ops aqc111_ethtool_ops = {
 static int aqc111_change_mtu(struct net_device *net, int new_mtu)
 {
 	struct usbnet *dev = netdev_priv(net);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
 	u16 reg16 = 0;
-	u8 buf[5];
 
 #if KERNEL_VERSION(4, 10, 0) > LINUX_VERSION_CODE
 	if (new_mtu <= 0 || new_mtu > 16334)
@@ -689,36 +1649,34 @@ static int aqc111_change_mtu(struct net_device *net, int new_mtu)
 
 	net->mtu = new_mtu;
 	dev->hard_mtu = net->mtu + net->hard_header_len;
+	/* RX URBs are URB_SIZE for any MTU, only tx_qlen follows hard_mtu */
+	usbnet_update_max_qlen(dev);
+
+	/* Otherwise link_reset() programs the MAC for the new MTU */
+	if (!netif_running(net) || !aqc111_data->link)
+		return 0;
+
+	/* Hold the receive path only while the MAC is reprogrammed */
+	usbnet_pause_rx(dev);
 
 	aqc111_read16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
 			  2, &reg16);
+	reg16 &= ~SFR_MEDIUM_RECEIVE_EN;
+	aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
+			   2, &reg16);
+
+	aqc111_set_bulkin(dev, aqc111_data);
+	aqc111_set_water_level(dev);
+
 	if (net->mtu > 1500)
 		reg16 |= SFR_MEDIUM_JUMBO_EN;
 	else
 		reg16 &= ~SFR_MEDIUM_JUMBO_EN;
-
+	reg16 |= SFR_MEDIUM_RECEIVE_EN;
 	aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
 			   2, &reg16);
 
-	if (dev->net->mtu > 12500) {
-		memcpy(buf, &AQC111_BULKIN_SIZE[2], 5);
-		/* RX bulk configuration */
-		aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_RX_BULKIN_QCTRL,
-				 5, 5, buf);
-	}
-
-	/* Set high low water level */
-	if (dev->net->mtu <= 4500)
-		reg16 = 0x0810;
-	else if (dev->net->mtu <= 9500)
-		reg16 = 0x1020;
-	else if (dev->net->mtu <= 12500)
-		reg16 = 0x1420;
-	else
-		reg16 = 0x1A20;
-
-	aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_PAUSE_WATERLVL_LOW,
-			   2, &reg16);
+	usbnet_resume_rx(dev);
 
 	return 0;
 }
@@ -852,12 +1810,12 @@ static int aqc111_set_features(struct net_device *net,
 		aqc111_read_cmd(dev, AQ_ACCESS_MAC, SFR_RXCOE_CTL, 1, 1, &reg8);
 		if (features & NETIF_F_RXCSUM) {
 			aqc111_data->rx_checksum = 1;
-			reg8 &= ~(SFR_RXCOE_IP | SFR_RXCOE_TCP | SFR_RXCOE_UDP |
-				  SFR_RXCOE_TCPV6 | SFR_RXCOE_UDPV6);
-		} else {
-			aqc111_data->rx_checksum = 0;
 			reg8 |= SFR_RXCOE_IP | SFR_RXCOE_TCP | SFR_RXCOE_UDP |
 				SFR_RXCOE_TCPV6 | SFR_RXCOE_UDPV6;
+		} else {
+			aqc111_data->rx_checksum = 0;
+			reg8 &= ~(SFR_RXCOE_IP | SFR_RXCOE_TCP | SFR_RXCOE_UDP |
+				  SFR_RXCOE_TCPV6 | SFR_RXCOE_UDPV6);
 		}
 
 		aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_RXCOE_CTL,
@@ -899,10 +1857,81 @@ static int aqc111_set_features(struct net_device *net,
 	return 0;
 }
 
+static u16 aqc111_tx_band(struct sk_buff *skb)
+{
+	u8 dsfield = 0;
+
+	switch (skb->priority) {
+	case TC_PRIO_INTERACTIVE:
+	case TC_PRIO_CONTROL:
+		return AQ_TX_BAND_PRIO;
+	}
+
+	if (skb->protocol == htons(ETH_P_IP)) {
+		struct iphdr _iph, *iph;
+
+		iph = skb_header_pointer(skb, skb_network_offset(skb),
+					 sizeof(_iph), &_iph);
+		if (iph)
+			dsfield = ipv4_get_dsfield(iph);
+	} else if (skb->protocol == htons(ETH_P_IPV6)) {
+		struct ipv6hdr _ip6h, *ip6h;
+
+		ip6h = skb_header_pointer(skb, skb_network_offset(skb),
+					  sizeof(_ip6h), &_ip6h);
+		if (ip6h)
+			dsfield = ipv6_get_dsfield(ip6h);
+	}
+
+	return (dsfield >> 2) >= AQ_TX_PRIO_DSCP ? AQ_TX_BAND_PRIO :
+						   AQ_TX_BAND_BULK;
+}
+
+#if KERNEL_VERSION(5, 2, 0) <= LINUX_VERSION_CODE
+static u16 aqc111_select_queue(struct net_device *net, struct sk_buff *skb,
+			       struct net_device *sb_dev)
+#elif KERNEL_VERSION(4, 19, 0) <= LINUX_VERSION_CODE
+static u16 aqc111_select_queue(struct net_device *net, struct sk_buff *skb,
+			       struct net_device *sb_dev,
+			       select_queue_fallback_t fallback)
+#elif KERNEL_VERSION(3, 14, 0) <= LINUX_VERSION_CODE || (RHEL_RELEASE_CODE)
+static u16 aqc111_select_queue(struct net_device *net, struct sk_buff *skb,
+			       void *accel_priv,
+			       select_queue_fallback_t fallback)
+#elif KERNEL_VERSION(3, 13, 0) <= LINUX_VERSION_CODE
+static u16 aqc111_select_queue(struct net_device *net, struct sk_buff *skb,
+			       void *accel_priv)
+#else
+static u16 aqc111_select_queue(struct net_device *net, struct sk_buff *skb)
+#endif
+{
+	if (net->real_num_tx_queues < AQ_TX_BANDS)
+		return 0;
+
+	return aqc111_tx_band(skb);
+}
+
+#ifdef AQ_SW_GSO
+/* TXCOE parses the outer headers only, so a single tunnelled packet
+ * is checksummed by the stack. GSO packets keep the checksum features
+ * to stay whole; aqc111_tx_gso() computes their inner checksums.
+ */
+static netdev_features_t aqc111_features_check(struct sk_buff *skb,
+					       struct net_device *net,
+					       netdev_features_t features)
+{
+	if (skb->encapsulation && !skb_is_gso(skb))
+		features &= ~NETIF_F_CSUM_MASK;
+
+	return vlan_features_check(skb, features);
+}
+#endif
+
 static const struct net_device_ops aqc111_netdev_ops = {
 	.ndo_open		= usbnet_open,
 	.ndo_stop		= usbnet_stop,
 	.ndo_start_xmit		= usbnet_start_xmit,
+	.ndo_select_queue	= aqc111_select_queue,
 	.ndo_tx_timeout		= usbnet_tx_timeout,
 	.ndo_get_stats64	= usbnet_get_stats64,
 #if (RHEL_RELEASE_VERSION(7, 5) <= RHEL_RELEASE_CODE)
@@ -917,6 +1946,9 @@ static const struct net_device_ops aqc111_netdev_ops = {
 	.ndo_vlan_rx_kill_vid	= aqc111_vlan_rx_kill_vid,
 	.ndo_set_rx_mode	= aqc111_set_rx_mode,
 	.ndo_set_features	= aqc111_set_features,
+#ifdef AQ_SW_GSO
+	.ndo_features_check	= aqc111_features_check,
+#endif
 };
 
 static int aqc111_read_perm_mac(struct usbnet *dev)
@@ -951,6 +1983,302 @@ static void aqc111_read_fw_version(struct usbnet *dev,
 		aqc111_data->dpa = 1;
 }
 
+static const u8 aqc111_thermal_step_default[AQ_THERMAL_STEPS] = {
+	[AQ_THERMAL_STEP_XFI_DIV_2 - 1] = 90,
+	[AQ_THERMAL_STEP_2G5 - 1] = 95,
+	[AQ_THERMAL_STEP_1G - 1] = 100,
+	[AQ_THERMAL_STEP_100M - 1] = 104,
+};
+
+static struct aqc111_data *aqc111_sysfs_data(struct device *d)
+{
+	struct usbnet *dev = netdev_priv(to_net_dev(d));
+
+	return dev->driver_priv;
+}
+
+static ssize_t aqc111_step_temp_show(struct device *d,
+				     struct device_attribute *attr, char *buf)
+{
+	struct aqc111_data *aqc111_data = aqc111_sysfs_data(d);
+	u8 *step = aqc111_data->thermal_step;
+
+	return sprintf(buf, "%u %u %u %u\n", step[0], step[1], step[2],
+		       step[3]);
+}
+
+static ssize_t aqc111_step_temp_store(struct device *d,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct aqc111_data *aqc111_data = aqc111_sysfs_data(d);
+	unsigned int step[AQ_THERMAL_STEPS];
+	int i;
+
+	if (sscanf(buf, "%u %u %u %u", &step[0], &step[1], &step[2],
+		   &step[3]) != AQ_THERMAL_STEPS)
+		return -EINVAL;
+
+	for (i = 0; i < AQ_THERMAL_STEPS; i++)
+		if (step[i] > AQ_CRITICAL_TEMP_THRESHOLD ||
+		    (i && step[i] <= step[i - 1]))
+			return -EINVAL;
+
+	if (!rtnl_trylock())
+		return restart_syscall();
+	for (i = 0; i < AQ_THERMAL_STEPS; i++)
+		aqc111_data->thermal_step[i] = step[i];
+	rtnl_unlock();
+
+	return count;
+}
+
+static ssize_t aqc111_hysteresis_show(struct device *d,
+				      struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", aqc111_sysfs_data(d)->thermal_hyst);
+}
+
+static ssize_t aqc111_hysteresis_store(struct device *d,
+				       struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct aqc111_data *aqc111_data = aqc111_sysfs_data(d);
+	u8 hyst;
+	int ret;
+
+	ret = kstrtou8(buf, 0, &hyst);
+	if (ret)
+		return ret;
+	if (hyst > AQ_THERMAL_MAX_HYSTERESIS)
+		return -EINVAL;
+
+	aqc111_data->thermal_hyst = hyst;
+
+	return count;
+}
+
+static ssize_t aqc111_level_show(struct device *d,
+				 struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", aqc111_sysfs_data(d)->thermal_level);
+}
+
+static ssize_t aqc111_load_show(struct device *d,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", aqc111_sysfs_data(d)->gov.load);
+}
+
+static ssize_t aqc111_busy_load_show(struct device *d,
+				     struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", aqc111_sysfs_data(d)->gov.busy_load);
+}
+
+static ssize_t aqc111_busy_load_store(struct device *d,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct aqc111_data *aqc111_data = aqc111_sysfs_data(d);
+	u8 load;
+	int ret;
+
+	ret = kstrtou8(buf, 0, &load);
+	if (ret)
+		return ret;
+	if (load > 100 || load < aqc111_data->gov.idle_load)
+		return -EINVAL;
+
+	aqc111_data->gov.busy_load = load;
+
+	return count;
+}
+
+static ssize_t aqc111_idle_load_show(struct device *d,
+				     struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", aqc111_sysfs_data(d)->gov.idle_load);
+}
+
+static ssize_t aqc111_idle_load_store(struct device *d,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct aqc111_data *aqc111_data = aqc111_sysfs_data(d);
+	u8 load;
+	int ret;
+
+	ret = kstrtou8(buf, 0, &load);
+	if (ret)
+		return ret;
+	if (load > aqc111_data->gov.busy_load)
+		return -EINVAL;
+
+	aqc111_data->gov.idle_load = load;
+
+	return count;
+}
+
+static ssize_t aqc111_sustain_ms_show(struct device *d,
+				      struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", aqc111_sysfs_data(d)->gov.sustain_ms);
+}
+
+static ssize_t aqc111_sustain_ms_store(struct device *d,
+				       struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct aqc111_data *aqc111_data = aqc111_sysfs_data(d);
+	u32 sustain;
+	int ret;
+
+	ret = kstrtou32(buf, 0, &sustain);
+	if (ret)
+		return ret;
+	if (sustain > AQ_GOV_MAX_SUSTAIN_MS)
+		return -EINVAL;
+
+	aqc111_data->gov.sustain_ms = sustain;
+
+	return count;
+}
+
+static DEVICE_ATTR(step_temp, 0644, aqc111_step_temp_show,
+		   aqc111_step_temp_store);
+static DEVICE_ATTR(hysteresis, 0644, aqc111_hysteresis_show,
+		   aqc111_hysteresis_store);
+static DEVICE_ATTR(level, 0444, aqc111_level_show, NULL);
+static DEVICE_ATTR(load, 0444, aqc111_load_show, NULL);
+static DEVICE_ATTR(busy_load, 0644, aqc111_busy_load_show,
+		   aqc111_busy_load_store);
+static DEVICE_ATTR(idle_load, 0644, aqc111_idle_load_show,
+		   aqc111_idle_load_store);
+static DEVICE_ATTR(sustain_ms, 0644, aqc111_sustain_ms_show,
+		   aqc111_sustain_ms_store);
+
+static struct attribute *aqc111_thermal_attrs[] = {
+	&dev_attr_step_temp.attr,
+	&dev_attr_hysteresis.attr,
+	&dev_attr_level.attr,
+	&dev_attr_load.attr,
+	&dev_attr_busy_load.attr,
+	&dev_attr_idle_load.attr,
+	&dev_attr_sustain_ms.attr,
+	NULL,
+};
+
+static const struct attribute_group aqc111_thermal_group = {
+	.name	= "thermal",
+	.attrs	= aqc111_thermal_attrs,
+};
+
+#ifdef AQ_HWMON
+static ssize_t aqc111_temp_input_show(struct device *d,
+				      struct device_attribute *attr, char *buf)
+{
+	struct aqc111_data *aqc111_data = dev_get_drvdata(d);
+
+	if (!aqc111_data->temp_valid)
+		return -ENODATA;
+
+	return sprintf(buf, "%d\n", aqc111_data->temp);
+}
+
+/* Firmware thresholds as programmed by aqc111_update_thermal_params() */
+static ssize_t aqc111_temp_max_show(struct device *d,
+				    struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", AQ_HIGH_TEMP_THRESHOLD * 1000);
+}
+
+static ssize_t aqc111_temp_max_hyst_show(struct device *d,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	return sprintf(buf, "%d\n", AQ_NORMAL_TEMP_THRESHOLD * 1000);
+}
+
+static ssize_t aqc111_temp_crit_show(struct device *d,
+				     struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", AQ_CRITICAL_TEMP_THRESHOLD * 1000);
+}
+
+static ssize_t aqc111_throttle_active_show(struct device *d,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct aqc111_data *aqc111_data = dev_get_drvdata(d);
+
+	return sprintf(buf, "%u\n", aqc111_data->thermal_level ? 1 : 0);
+}
+
+static ssize_t aqc111_throttle_count_show(struct device *d,
+					  struct device_attribute *attr,
+					  char *buf)
+{
+	struct aqc111_data *aqc111_data = dev_get_drvdata(d);
+
+	return sprintf(buf, "%u\n", aqc111_data->thermal_events);
+}
+
+static ssize_t aqc111_update_interval_show(struct device *d,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct aqc111_data *aqc111_data = dev_get_drvdata(d);
+
+	return sprintf(buf, "%u\n", aqc111_data->thermal_interval);
+}
+
+static ssize_t aqc111_update_interval_store(struct device *d,
+					    struct device_attribute *attr,
+					    const char *buf, size_t count)
+{
+	struct aqc111_data *aqc111_data = dev_get_drvdata(d);
+	unsigned int interval;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &interval);
+	if (ret)
+		return ret;
+
+	aqc111_data->thermal_interval = clamp_t(unsigned int, interval,
+						AQ_THERMAL_MIN_TIMER_MS,
+						AQ_THERMAL_MAX_TIMER_MS);
+
+	return count;
+}
+
+static DEVICE_ATTR(temp1_input, 0444, aqc111_temp_input_show, NULL);
+static DEVICE_ATTR(temp1_max, 0444, aqc111_temp_max_show, NULL);
+static DEVICE_ATTR(temp1_max_hyst, 0444, aqc111_temp_max_hyst_show, NULL);
+static DEVICE_ATTR(temp1_crit, 0444, aqc111_temp_crit_show, NULL);
+static DEVICE_ATTR(throttle_active, 0444, aqc111_throttle_active_show, NULL);
+static DEVICE_ATTR(throttle_count, 0444, aqc111_throttle_count_show, NULL);
+static DEVICE_ATTR(update_interval, 0644, aqc111_update_interval_show,
+		   aqc111_update_interval_store);
+
+static struct attribute *aqc111_hwmon_attrs[] = {
+	&dev_attr_temp1_input.attr,
+	&dev_attr_temp1_max.attr,
+	&dev_attr_temp1_max_hyst.attr,
+	&dev_attr_temp1_crit.attr,
+	&dev_attr_throttle_active.attr,
+	&dev_attr_throttle_count.attr,
+	&dev_attr_update_interval.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(aqc111_hwmon);
+#endif
+
+static const unsigned int aqc111_tx_band_limit[AQ_TX_BANDS] = {
+	[AQ_TX_BAND_PRIO] = 0,
+	[AQ_TX_BAND_BULK] = AQ_TX_BULK_MIN,
+};
+
 static int aqc111_bind(struct usbnet *dev, struct usb_interface *intf)
 {
 	struct usb_device *udev = interface_to_usbdev(intf);
@@ -981,6 +2309,9 @@ static int aqc111_bind(struct usbnet *dev, struct usb_interface *intf)
 
 	/* store aqc111_data pointer in device data field */
 	dev->driver_priv = aqc111_data;
+	aqc111_data->dev = dev;
+	INIT_DELAYED_WORK(&aqc111_data->thermal_work, aqc111_thermal_work);
+	INIT_DELAYED_WORK(&aqc111_data->phy_work, aqc111_phy_work);
 
 	/* Init the MAC address */
 	ret = aqc111_read_perm_mac(dev);
@@ -1005,23 +2336,69 @@ static int aqc111_bind(struct usbnet *dev, struct usb_interface *intf)
 	dev->net->netdev_ops = &aqc111_netdev_ops;
 	dev->net->ethtool_ops = &aqc111_ethtool_ops;
 
-#if KERNEL_VERSION(3, 12, 0) <= LINUX_VERSION_CODE || (RHEL_RELEASE_CODE)
-	if (usb_device_no_sg_constraint(dev->udev))
-		dev->can_dma_sg = 1;
-#endif
+	usbnet_enable_dma_sg(dev);
 
 	dev->net->hw_features |= AQ_SUPPORT_HW_FEATURE;
 	dev->net->features |= AQ_SUPPORT_FEATURE;
 	dev->net->vlan_features |= AQ_SUPPORT_VLAN_FEATURE;
+#ifdef AQ_SW_GSO
+	dev->net->hw_enc_features |= AQ_SUPPORT_ENC_FEATURE;
+#endif
+	/* Only enabled here: the stack turns LRO off for forwarding */
+	dev->net->features |= NETIF_F_LRO;
+
+	/* BIG TCP is raised by the "Big TSO" private flag */
+#if KERNEL_VERSION(6, 0, 0) <= LINUX_VERSION_CODE
+	netif_set_tso_max_size(dev->net, AQ_TSO_LEGACY_SIZE);
+#else
+	netif_set_gso_max_size(dev->net, AQ_TSO_LEGACY_SIZE);
+#endif
 
-	netif_set_gso_max_size(dev->net, 65535);
+	ret = usbnet_set_tx_bands(dev, AQ_TX_BANDS, aqc111_tx_band_limit);
+	if (ret)
+		goto out;
 
 	aqc111_read_fw_version(dev, aqc111_data);
+#ifdef CONFIG_SYSFS
+	/* The steps and the load gate need the PHY temperature */
+	if (aqc111_data->dpa)
+		dev->net->sysfs_groups[0] = &aqc111_thermal_group;
+#endif
 	aqc111_data->autoneg = AUTONEG_ENABLE;
 	aqc111_data->advertised_speed = (usb_speed == USB_SPEED_SUPER) ?
 					 SPEED_5000 : SPEED_1000;
 	aqc111_data->priv_flags |= AQ_PF_THERMAL;
+	aqc111_data->eee_adv = AQ_EEE_SUPPORTED;
+	aqc111_data->pause_autoneg = true;
+	aqc111_data->rx_pause = true;
+	aqc111_data->tx_pause = true;
+	memcpy(aqc111_data->thermal_step, aqc111_thermal_step_default,
+	       sizeof(aqc111_data->thermal_step));
+	aqc111_data->thermal_hyst = AQ_THERMAL_HYSTERESIS;
+	aqc111_data->thermal_interval = AQ_THERMAL_TIMER_MS;
+	aqc111_data->gov.busy_load = AQ_GOV_BUSY_LOAD;
+	aqc111_data->gov.idle_load = AQ_GOV_IDLE_LOAD;
+	aqc111_data->gov.sustain_ms = AQ_GOV_SUSTAIN_MS;
 	aqc111_data->rx_checksum = 1;
+	aqc111_data->rx_copybreak = AQ_RX_COPYBREAK_MAX;
+	aqc111_data->wl.scale = AQ_WL_SCALE_BASE;
+
+#ifdef AQ_HWMON
+	/* Monitoring only, the driver works without it. The temperature
+	 * and the throttle state need direct PHY access.
+	 */
+	if (aqc111_data->dpa) {
+		aqc111_data->hwmon =
+			hwmon_device_register_with_groups(&intf->dev, "aqc111",
+							  aqc111_data,
+							  aqc111_hwmon_groups);
+		if (IS_ERR(aqc111_data->hwmon)) {
+			netdev_warn(dev->net,
+				    "Failed to register hwmon device\n");
+			aqc111_data->hwmon = NULL;
+		}
+	}
+#endif
 
 	return 0;
 
@@ -1036,6 +2413,13 @@ static void aqc111_unbind(struct usbnet *dev, struct usb_interface *intf)
 	u16 reg16;
 	u8 reg8;
 
+	aqc111_thermal_stop(dev);
+	aqc111_phy_work_cancel(dev);
+#ifdef AQ_HWMON
+	if (aqc111_data->hwmon)
+		hwmon_device_unregister(aqc111_data->hwmon);
+#endif
+
 	/* Force bz */
 	reg16 = SFR_PHYPWR_RSTCTL_BZ;
 	aqc111_write16_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_PHYPWR_RSTCTL,
@@ -1081,8 +2465,18 @@ static void aqc111_status(struct usbnet *dev, struct urb *urb)
 				  AQ_SPEED_SHIFT;
 	aqc111_data->link = link;
 
-	if (netif_carrier_ok(dev->net) != link)
+	if (netif_carrier_ok(dev->net) != link) {
+		if (link) {
+			aqc111_data->link_event = ktime_get();
+		} else {
+			/* Let bonding fail over now, link_reset() stops the
+			 * MAC once keventd gets to it
+			 */
+			netif_carrier_off(dev->net);
+			aqc111_data->link_down_event = ktime_get();
+		}
 		usbnet_defer_kevent(dev, EVENT_LINK_RESET);
+	}
 }
 
 static void aqc111_configure_rx(struct usbnet *dev,
@@ -1091,7 +2485,6 @@ static void aqc111_configure_rx(struct usbnet *dev,
 	enum usb_device_speed usb_speed = dev->udev->speed;
 	u16 link_speed = 0, usb_host = 0;
 	u8 buf[5] = { 0 };
-	u8 queue_num = 0;
 	u16 reg16 = 0;
 	u8 reg8 = 0;
 
@@ -1114,7 +2507,6 @@ static void aqc111_configure_rx(struct usbnet *dev,
 		break;
 	case AQ_INT_SPEED_100M:
 		link_speed = 100;
-		queue_num = 1;
 		reg16 = 0x063F;
 		buf[1] = 0xFB;
 		buf[2] = 0x4;
@@ -1144,32 +2536,15 @@ static void aqc111_configure_rx(struct usbnet *dev,
 	case USB_SPEED_FULL:
 	case USB_SPEED_LOW:
 		usb_host = 1;
-		queue_num = 0;
 		break;
 	default:
 		usb_host = 0;
 		break;
 	}
 
-	if (dev->net->mtu > 12500 && dev->net->mtu <= 16334)
-		queue_num = 2; /* For Jumbo packet 16KB */
-
-	memcpy(buf, &AQC111_BULKIN_SIZE[queue_num], 5);
-	/* RX bulk configuration */
-	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_RX_BULKIN_QCTRL, 5, 5, buf);
-
-	/* Set high low water level */
-	if (dev->net->mtu <= 4500)
-		reg16 = 0x0810;
-	else if (dev->net->mtu <= 9500)
-		reg16 = 0x1020;
-	else if (dev->net->mtu <= 12500)
-		reg16 = 0x1420;
-	else if (dev->net->mtu <= 16334)
-		reg16 = 0x1A20;
+	aqc111_set_bulkin(dev, aqc111_data);
+	aqc111_set_water_level(dev);
 
-	aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_PAUSE_WATERLVL_LOW,
-			   2, &reg16);
 	netdev_info(dev->net, "Link Speed %d, USB %d", link_speed, usb_host);
 }
 
@@ -1177,10 +2552,9 @@ static void aqc111_configure_csum_offload(struct usbnet *dev)
 {
 	u8 reg8 = 0;
 
-	if (dev->net->features & NETIF_F_RXCSUM) {
+	if (dev->net->features & NETIF_F_RXCSUM)
 		reg8 |= SFR_RXCOE_IP | SFR_RXCOE_TCP | SFR_RXCOE_UDP |
 			SFR_RXCOE_TCPV6 | SFR_RXCOE_UDPV6;
-	}
 	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_RXCOE_CTL, 1, 1, &reg8);
 
 	reg8 = 0;
@@ -1193,72 +2567,115 @@ static void aqc111_configure_csum_offload(struct usbnet *dev)
 	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_TXCOE_CTL, 1, 1, &reg8);
 }
 
-static int aqc111_link_reset(struct usbnet *dev)
+/* Time from an event to carrier on */
+static void aqc111_carrier_latency(ktime_t *event, u64 *last, u64 *max)
+{
+	s64 us;
+
+	if (!ktime_to_ns(*event))
+		return;
+
+	us = ktime_us_delta(ktime_get(), *event);
+	*event = ktime_set(0, 0);
+
+	*last = us;
+	if (us > *max)
+		*max = us;
+}
+
+static void aqc111_configure_mac(struct usbnet *dev,
+				 struct aqc111_data *aqc111_data)
 {
-	struct aqc111_data *aqc111_data = dev->driver_priv;
 	u16 reg16 = 0;
 	u8 reg8 = 0;
 
-	if (aqc111_data->link == 1) { /* Link up */
-		aqc111_configure_rx(dev, aqc111_data);
+	/* Vlan Tag Filter */
+	reg8 = SFR_VLAN_CONTROL_VSO;
+	if (dev->net->features & NETIF_F_HW_VLAN_CTAG_FILTER)
+		reg8 |= SFR_VLAN_CONTROL_VFE;
 
-		/* Vlan Tag Filter */
-		reg8 = SFR_VLAN_CONTROL_VSO;
-		if (dev->net->features & NETIF_F_HW_VLAN_CTAG_FILTER)
-			reg8 |= SFR_VLAN_CONTROL_VFE;
+	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_VLAN_ID_CONTROL,
+			 1, 1, &reg8);
 
-		aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_VLAN_ID_CONTROL,
-				 1, 1, &reg8);
+	reg8 = 0x0;
+	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_BMRX_DMA_CONTROL,
+			 1, 1, &reg8);
 
-		reg8 = 0x0;
-		aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_BMRX_DMA_CONTROL,
-				 1, 1, &reg8);
+	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_BMTX_DMA_CONTROL,
+			 1, 1, &reg8);
 
-		aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_BMTX_DMA_CONTROL,
-				 1, 1, &reg8);
+	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_ARC_CTRL, 1, 1, &reg8);
 
-		aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_ARC_CTRL, 1, 1, &reg8);
+	reg16 = SFR_RX_CTL_IPE | SFR_RX_CTL_AB;
+	aqc111_data->rxctl = reg16;
+	aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_RX_CTL, 2, &reg16);
 
-		reg16 = SFR_RX_CTL_IPE | SFR_RX_CTL_AB;
-		aqc111_data->rxctl = reg16;
-		aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_RX_CTL, 2, &reg16);
+	reg8 = SFR_RX_PATH_READY;
+	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_ETH_MAC_PATH,
+			 1, 1, &reg8);
 
-		reg8 = SFR_RX_PATH_READY;
-		aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_ETH_MAC_PATH,
-				 1, 1, &reg8);
+	reg8 = SFR_BULK_OUT_EFF_EN;
+	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_BULK_OUT_CTRL,
+			 1, 1, &reg8);
 
-		reg8 = SFR_BULK_OUT_EFF_EN;
-		aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_BULK_OUT_CTRL,
-				 1, 1, &reg8);
+	reg16 = 0;
+	aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
+			   2, &reg16);
 
-		reg16 = 0;
-		aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
-				   2, &reg16);
+	reg16 = SFR_MEDIUM_XGMIIMODE | SFR_MEDIUM_FULL_DUPLEX;
+	aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
+			   2, &reg16);
 
-		reg16 = SFR_MEDIUM_XGMIIMODE | SFR_MEDIUM_FULL_DUPLEX;
-		aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
-				   2, &reg16);
+	aqc111_configure_csum_offload(dev);
+
+	aqc111_set_rx_mode(dev->net);
+}
+
+static int aqc111_link_reset(struct usbnet *dev)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct aqc111_stats *stats = &aqc111_data->stats;
+	u16 reg16 = 0;
+	u8 reg8 = 0;
 
-		aqc111_configure_csum_offload(dev);
+	if (aqc111_data->link == 1) { /* Link up */
+		aqc111_configure_rx(dev, aqc111_data);
 
-		aqc111_set_rx_mode(dev->net);
+		/* Link down only stops the receiver and flushes bulk out,
+		 * everything else set up on the first link up still holds
+		 */
+		if (aqc111_data->mac_ready) {
+			stats->link_up_fast++;
+		} else {
+			aqc111_configure_mac(dev, aqc111_data);
+			stats->link_up_full++;
+		}
 
 		aqc111_read16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
 				  2, &reg16);
 
+		reg16 &= ~SFR_MEDIUM_JUMBO_EN;
 		if (dev->net->mtu > 1500)
 			reg16 |= SFR_MEDIUM_JUMBO_EN;
 
-		reg16 |= SFR_MEDIUM_RECEIVE_EN | SFR_MEDIUM_RXFLOW_CTRLEN |
-			 SFR_MEDIUM_TXFLOW_CTRLEN;
+		reg16 &= ~(SFR_MEDIUM_RXFLOW_CTRLEN | SFR_MEDIUM_TXFLOW_CTRLEN);
+		reg16 |= SFR_MEDIUM_RECEIVE_EN | aqc111_flow_ctrl(dev);
 		aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
 				   2, &reg16);
 
 		aqc111_data->rxctl |= SFR_RX_CTL_START;
 		aqc111_write16_cmd(dev, AQ_ACCESS_MAC, SFR_RX_CTL,
 				   2, &aqc111_data->rxctl);
+		aqc111_data->mac_ready = true;
+		aqc111_set_tx_bulk_limit(dev);
 
 		netif_carrier_on(dev->net);
+		aqc111_carrier_latency(&aqc111_data->link_event,
+				       &stats->link_up_last_us,
+				       &stats->link_up_max_us);
+		aqc111_carrier_latency(&aqc111_data->resume_event,
+				       &stats->resume_carrier_last_us,
+				       &stats->resume_carrier_max_us);
 	} else {
 		aqc111_read16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
 				  2, &reg16);
@@ -1278,6 +2695,9 @@ static int aqc111_link_reset(struct usbnet *dev)
 				 1, 1, &reg8);
 
 		netif_carrier_off(dev->net);
+		aqc111_carrier_latency(&aqc111_data->link_down_event,
+				       &stats->link_down_last_us,
+				       &stats->link_down_max_us);
 	}
 	return 0;
 }
@@ -1285,15 +2705,12 @@ static int aqc111_link_reset(struct usbnet *dev)
 static int aqc111_reset(struct usbnet *dev)
 {
 	struct aqc111_data *aqc111_data = dev->driver_priv;
-	u16 reg16 = 0;
 	u8 reg8 = 0;
 
 	dev->rx_urb_size = URB_SIZE;
+	aqc111_data->mac_ready = false;
 
-#if KERNEL_VERSION(3, 12, 0) <= LINUX_VERSION_CODE || (RHEL_RELEASE_CODE)
-	if (usb_device_no_sg_constraint(dev->udev))
-		dev->can_dma_sg = 1;
-#endif
+	usbnet_enable_dma_sg(dev);
 
 	dev->net->hw_features |= AQ_SUPPORT_HW_FEATURE;
 	dev->net->features |= AQ_SUPPORT_FEATURE;
@@ -1301,25 +2718,7 @@ static int aqc111_reset(struct usbnet *dev)
 
 	/* Power up ethernet PHY */
 	aqc111_data->phy_cfg = AQ_PHY_POWER_EN;
-	if (aqc111_data->dpa) {
-		aqc111_read_cmd(dev, AQ_PHY_POWER, 0, 0, 1, &reg8);
-		if (reg8 == 0x00) {
-			reg8 = 0x02;
-			aqc111_write_cmd(dev, AQ_PHY_POWER, 0, 0, 1, &reg8);
-			msleep(200);
-		}
-
-		aqc111_mdio_read(dev, AQ_GLB_STD_CTRL_REG, AQ_PHY_GLOBAL_ADDR,
-				 &reg16);
-		if (reg16 & AQ_PHY_LOW_POWER_MODE) {
-			reg16 &= ~AQ_PHY_LOW_POWER_MODE;
-			aqc111_mdio_write(dev, AQ_GLB_STD_CTRL_REG,
-					  AQ_PHY_GLOBAL_ADDR, &reg16);
-		}
-	} else {
-		aqc111_write32_cmd(dev, AQ_PHY_OPS, 0, 0,
-				   &aqc111_data->phy_cfg);
-	}
+	aqc111_phy_power_up(dev);
 
 	/* Set the MAC address */
 	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_NODE_ID, ETH_ALEN,
@@ -1345,6 +2744,8 @@ static int aqc111_reset(struct usbnet *dev)
 	aqc111_set_phy_speed(dev, aqc111_data->autoneg,
 			     aqc111_data->advertised_speed);
 
+	aqc111_thermal_start(dev);
+
 	return 0;
 }
 
@@ -1353,6 +2754,10 @@ static int aqc111_stop(struct usbnet *dev)
 	struct aqc111_data *aqc111_data = dev->driver_priv;
 	u16 reg16 = 0;
 
+	/* A PHY work queued by resume would power the PHY up again */
+	aqc111_phy_work_cancel(dev);
+	aqc111_thermal_stop(dev);
+
 	aqc111_read16_cmd(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
 			  2, &reg16);
 	reg16 &= ~SFR_MEDIUM_RECEIVE_EN;
@@ -1377,27 +2782,259 @@ static int aqc111_stop(struct usbnet *dev)
 	return 0;
 }
 
-static void aqc111_rx_checksum(struct sk_buff *skb, u64 *pkt_desc)
+static void aqc111_rx_checksum(struct aqc111_data *aqc111_data,
+			       struct sk_buff *skb, u64 *pkt_desc)
 {
 	u32 pkt_type = 0;
 
 	skb->ip_summed = CHECKSUM_NONE;
 	/* checksum error bit is set */
-	if (*pkt_desc & AQ_RX_PD_L4_ERR || *pkt_desc & AQ_RX_PD_L3_ERR)
+	if (*pkt_desc & AQ_RX_PD_L4_ERR || *pkt_desc & AQ_RX_PD_L3_ERR) {
+		aqc111_data->stats.rx_csum_err++;
 		return;
+	}
 
 	pkt_type = *pkt_desc & AQ_RX_PD_L4_TYPE_MASK;
-	/* It must be a TCP or UDP packet with a valid checksum */
-	if (pkt_type == AQ_RX_PD_L4_TCP || pkt_type == AQ_RX_PD_L4_UDP)
+	/* Only the TCP and UDP type codes are known; the descriptor carries
+	 * no information about inner headers of tunneled packets
+	 */
+	switch (pkt_type) {
+	case AQ_RX_PD_L4_TCP:
+	case AQ_RX_PD_L4_UDP:
 		skb->ip_summed = CHECKSUM_UNNECESSARY;
+		aqc111_data->stats.rx_csum_ok++;
+		break;
+	default:
+		aqc111_data->stats.rx_csum_none++;
+		break;
+	}
+}
+
+/* Returns TCP header of a frame which may be aggregated by LRO */
+static struct tcphdr *aqc111_lro_tcp_hdr(struct sk_buff *skb, u32 *tcp_off)
+{
+	struct ethhdr *eth = (struct ethhdr *)skb->data;
+	struct ipv6hdr *ip6h = NULL;
+	struct iphdr *iph = NULL;
+	struct tcphdr *th = NULL;
+	u32 ip_len = 0;
+	u32 flags = 0;
+
+	if (skb->ip_summed != CHECKSUM_UNNECESSARY || skb->len < ETH_HLEN)
+		return NULL;
+
+	switch (eth->h_proto) {
+	case htons(ETH_P_IP):
+		iph = (struct iphdr *)(eth + 1);
+		if (skb->len < ETH_HLEN + sizeof(*iph) || iph->ihl != 5 ||
+		    iph->protocol != IPPROTO_TCP ||
+		    (iph->frag_off & htons(IP_MF | IP_OFFSET)))
+			return NULL;
+		*tcp_off = ETH_HLEN + sizeof(*iph);
+		ip_len = ntohs(iph->tot_len);
+		break;
+	case htons(ETH_P_IPV6):
+		ip6h = (struct ipv6hdr *)(eth + 1);
+		if (skb->len < ETH_HLEN + sizeof(*ip6h) ||
+		    ip6h->nexthdr != IPPROTO_TCP)
+			return NULL;
+		*tcp_off = ETH_HLEN + sizeof(*ip6h);
+		ip_len = sizeof(*ip6h) + ntohs(ip6h->payload_len);
+		break;
+	default:
+		return NULL;
+	}
+
+	if (skb->len < ETH_HLEN + ip_len || ip_len < *tcp_off - ETH_HLEN +
+					       sizeof(*th))
+		return NULL;
+
+	th = (struct tcphdr *)(skb->data + *tcp_off);
+	flags = tcp_flag_word(th) & (TCP_FLAG_CWR | TCP_FLAG_ECE |
+				     TCP_FLAG_URG | TCP_FLAG_ACK |
+				     TCP_FLAG_PSH | TCP_FLAG_RST |
+				     TCP_FLAG_SYN | TCP_FLAG_FIN);
+	/* Only data segments carrying nothing but ACK/PSH are merged */
+	if (th->doff < 5 || (flags & ~TCP_FLAG_PSH) != TCP_FLAG_ACK ||
+	    ETH_HLEN + ip_len <= *tcp_off + th->doff * 4)
+		return NULL;
+
+	/* Drop Ethernet padding so that payload length is exact */
+	skb_trim(skb, ETH_HLEN + ip_len);
+
+	return th;
+}
+
+static bool aqc111_lro_match(struct aqc111_lro *lro, struct sk_buff *skb,
+			     struct tcphdr *th)
+{
+	struct sk_buff *head = lro->head;
+	struct tcphdr *head_th = (struct tcphdr *)(head->data + lro->tcp_off);
+	struct ethhdr *eth = (struct ethhdr *)skb->data;
+
+	if (lro->tcp_off + th->doff * 4 != lro->hdr_len ||
+	    skb_vlan_tag_present(head) != skb_vlan_tag_present(skb) ||
+	    head->vlan_tci != skb->vlan_tci ||
+	    memcmp(head->data, skb->data, ETH_HLEN))
+		return false;
+
+	if (eth->h_proto == htons(ETH_P_IP)) {
+		struct iphdr *head_iph = (struct iphdr *)(head->data + ETH_HLEN);
+		struct iphdr *iph = (struct iphdr *)(skb->data + ETH_HLEN);
+
+		if (iph->saddr != head_iph->saddr ||
+		    iph->daddr != head_iph->daddr ||
+		    iph->tos != head_iph->tos ||
+		    iph->ttl != head_iph->ttl ||
+		    iph->frag_off != head_iph->frag_off)
+			return false;
+	} else {
+		struct ipv6hdr *head_ip6h = (struct ipv6hdr *)(head->data +
+							       ETH_HLEN);
+		struct ipv6hdr *ip6h = (struct ipv6hdr *)(skb->data + ETH_HLEN);
+
+		/* Version, traffic class and flow label */
+		if (*(__be32 *)ip6h != *(__be32 *)head_ip6h ||
+		    ip6h->hop_limit != head_ip6h->hop_limit ||
+		    !ipv6_addr_equal(&ip6h->saddr, &head_ip6h->saddr) ||
+		    !ipv6_addr_equal(&ip6h->daddr, &head_ip6h->daddr))
+			return false;
+	}
+
+	return th->source == head_th->source && th->dest == head_th->dest &&
+	       th->ack_seq == head_th->ack_seq &&
+	       th->window == head_th->window &&
+	       ntohl(th->seq) == lro->next_seq &&
+	       !memcmp(th + 1, head_th + 1, th->doff * 4 - sizeof(*th));
+}
+
+static void aqc111_lro_flush(struct usbnet *dev, struct aqc111_lro *lro)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct sk_buff *head = lro->head;
+	struct ethhdr *eth = NULL;
+
+	if (!head)
+		return;
+
+	eth = (struct ethhdr *)head->data;
+	if (lro->segs > 1) {
+		if (eth->h_proto == htons(ETH_P_IP)) {
+			struct iphdr *iph = (struct iphdr *)(eth + 1);
+
+			iph->tot_len = htons(head->len - ETH_HLEN);
+			iph->check = 0;
+			iph->check = ip_fast_csum((u8 *)iph, iph->ihl);
+			skb_shinfo(head)->gso_type = SKB_GSO_TCPV4;
+		} else {
+			struct ipv6hdr *ip6h = (struct ipv6hdr *)(eth + 1);
+
+			ip6h->payload_len = htons(head->len - ETH_HLEN -
+						  sizeof(*ip6h));
+			skb_shinfo(head)->gso_type = SKB_GSO_TCPV6;
+		}
+		skb_shinfo(head)->gso_size = lro->mss;
+		skb_shinfo(head)->gso_segs = lro->segs;
+		aqc111_data->stats.rx_lro_flushed++;
+	}
+
+	usbnet_skb_return(dev, head);
+	lro->head = NULL;
+	lro->tail = NULL;
+}
+
+static bool aqc111_lro_merge(struct aqc111_lro *lro, struct sk_buff *skb,
+			     struct tcphdr *th, u32 payload)
+{
+	struct sk_buff *head = lro->head;
+	struct tcphdr *head_th = NULL;
+
+	/* The head gets a frag_list, it must not share skb_shinfo() with
+	 * the other frames cloned out of the URB buffer
+	 */
+	if (skb_cloned(head)) {
+		head = skb_copy_expand(lro->head, NET_SKB_PAD + NET_IP_ALIGN,
+				       0, GFP_ATOMIC);
+		if (!head)
+			return false;
+
+		dev_kfree_skb_any(lro->head);
+		lro->head = head;
+		lro->tail = head;
+	}
+
+	head_th = (struct tcphdr *)(head->data + lro->tcp_off);
+	head_th->psh |= th->psh;
+
+	skb_pull(skb, lro->hdr_len);
+	if (lro->tail == head)
+		skb_shinfo(head)->frag_list = skb;
+	else
+		lro->tail->next = skb;
+	lro->tail = skb;
+
+	head->len += skb->len;
+	head->data_len += skb->len;
+	head->truesize += skb->truesize;
+
+	lro->next_seq += payload;
+	lro->segs++;
+
+	return true;
+}
+
+static void aqc111_lro_receive(struct usbnet *dev, struct aqc111_lro *lro,
+			       struct sk_buff *skb)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct tcphdr *th = NULL;
+	u32 tcp_off = 0;
+	u32 payload = 0;
+
+	th = aqc111_lro_tcp_hdr(skb, &tcp_off);
+	if (!th) {
+		aqc111_lro_flush(dev, lro);
+		usbnet_skb_return(dev, skb);
+		return;
+	}
+
+	payload = skb->len - tcp_off - th->doff * 4;
+
+	if (lro->head && payload <= lro->mss &&
+	    lro->head->len - ETH_HLEN + payload <= AQ_LRO_MAX_SIZE &&
+	    aqc111_lro_match(lro, skb, th) &&
+	    aqc111_lro_merge(lro, skb, th, payload)) {
+		aqc111_data->stats.rx_lro_merged++;
+		/* Short or pushed segment ends the train */
+		if (th->psh || payload < lro->mss)
+			aqc111_lro_flush(dev, lro);
+		return;
+	}
+
+	aqc111_lro_flush(dev, lro);
+
+	if (th->psh) {
+		usbnet_skb_return(dev, skb);
+		return;
+	}
+
+	lro->head = skb;
+	lro->tail = skb;
+	lro->tcp_off = tcp_off;
+	lro->hdr_len = tcp_off + th->doff * 4;
+	lro->next_seq = ntohl(th->seq) + payload;
+	lro->mss = payload;
+	lro->segs = 1;
 }
 
 static int aqc111_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
 {
 	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct aqc111_lro lro = { NULL };
 	struct sk_buff *new_skb = NULL;
 	u32 pkt_total_offset = 0;
 	u32 start_of_descs = 0;
+	unsigned int clone_truesize;
 	u64 *pkt_desc = NULL;
 	u32 desc_offset = 0; /*RX Header Offset*/
 	u16 pkt_count = 0;
@@ -1439,6 +3076,13 @@ static int aqc111_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
 	if (pkt_count == 0)
 		goto err;
 
+	/* A clone pins the whole URB buffer, charge each its share */
+	clone_truesize = skb->truesize / pkt_count;
+
+	/* Transfers still waiting for usbnet_bh behind this one */
+	aqc111_data->wl.backlog = max_t(u32, aqc111_data->wl.backlog,
+					skb_queue_len(&dev->done));
+
 	/* Get the first RX packet descriptor */
 	pkt_desc = (u64 *)(skb->data + desc_offset);
 
@@ -1457,22 +3101,38 @@ static int aqc111_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
 			goto err;
 		}
 
+		if (*pkt_desc & AQ_RX_PD_DROP) {
+			aqc111_data->stats.rx_pd_drop++;
+			usbnet_rx_dropped(dev);
+		}
+
 		if (*pkt_desc & AQ_RX_PD_DROP ||
 		    !(*pkt_desc & AQ_RX_PD_RX_OK) ||
 		    pkt_len > (dev->hard_mtu + AQ_RX_HW_PAD))
 			goto next_desc;
 
-		new_skb = netdev_alloc_skb_ip_align(dev->net, pkt_len);
+		if (pkt_len <= aqc111_data->rx_copybreak) {
+			new_skb = netdev_alloc_skb_ip_align(dev->net, pkt_len);
+			if (!new_skb)
+				goto err;
 
-		if (!new_skb)
-			goto err;
-
-		skb_put_data(new_skb, skb->data, pkt_len);
+			skb_put_data(new_skb, skb->data, pkt_len);
+			aqc111_data->stats.rx_copy++;
+		} else {
+			/* Deliver by reference into the URB buffer */
+			new_skb = skb_clone(skb, GFP_ATOMIC);
+			if (!new_skb)
+				goto err;
+
+			new_skb->len = pkt_len;
+			skb_set_tail_pointer(new_skb, pkt_len);
+			new_skb->truesize = clone_truesize;
+			aqc111_data->stats.rx_clone++;
+		}
 		skb_pull(new_skb, AQ_RX_HW_PAD);
 
-		new_skb->truesize = SKB_TRUESIZE(new_skb->len);
 		if (aqc111_data->rx_checksum)
-			aqc111_rx_checksum(new_skb, pkt_desc);
+			aqc111_rx_checksum(aqc111_data, new_skb, pkt_desc);
 
 		if (*pkt_desc & AQ_RX_PD_VLAN) {
 			vlan_tag = *pkt_desc >> AQ_RX_PD_VLAN_SHIFT;
@@ -1480,7 +3140,10 @@ static int aqc111_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
 					       vlan_tag & VLAN_VID_MASK);
 		}
 
-		usbnet_skb_return(dev, new_skb);
+		if (dev->net->features & NETIF_F_LRO)
+			aqc111_lro_receive(dev, &lro, new_skb);
+		else
+			usbnet_skb_return(dev, new_skb);
 		if (pkt_count == 0)
 			break;
 
@@ -1493,13 +3156,39 @@ next_desc:
 		new_skb = NULL;
 	}
 
+	aqc111_lro_flush(dev, &lro);
+
 	return 1;
 
 err:
+	aqc111_lro_flush(dev, &lro);
 	return 0;
 }
 
-static struct sk_buff *aqc111_tx_fixup(struct usbnet *dev, struct sk_buff *skb,
+/* Pad a paged frame with a zero page fragment, copying a BIG TCP frame
+ * into one linear buffer would need a high order atomic allocation.
+ */
+static int aqc111_tx_pad_frags(struct sk_buff *skb, int padding_size,
+			       gfp_t flags)
+{
+	int nr_frags = skb_shinfo(skb)->nr_frags;
+
+	if (nr_frags >= MAX_SKB_FRAGS || skb_unclone(skb, flags))
+		return -ENOMEM;
+
+	get_page(ZERO_PAGE(0));
+	skb_fill_page_desc(skb, nr_frags, ZERO_PAGE(0), 0, padding_size);
+	skb->len += padding_size;
+	skb->data_len += padding_size;
+
+	return 0;
+}
+
+/* Frame one packet of a transfer, offset is the length of the frames
+ * before it. Only the last frame can end on a packet boundary.
+ */
+static struct sk_buff *aqc111_tx_frame(struct usbnet *dev, struct sk_buff *skb,
+				       unsigned int offset, bool last,
 				       gfp_t flags)
 {
 	int frame_size = dev->maxpacket;
@@ -1510,6 +3199,11 @@ static struct sk_buff *aqc111_tx_fixup(struct usbnet *dev, struct sk_buff *skb,
 	u64 tx_desc = 0;
 	u16 tci = 0;
 
+	if (unlikely(skb->len > AQ_TX_DESC_LEN_MASK)) {
+		dev_kfree_skb_any(skb);
+		return NULL;
+	}
+
 	/*Length of actual data*/
 	tx_desc |= skb->len & AQ_TX_DESC_LEN_MASK;
 
@@ -1521,7 +3215,8 @@ static struct sk_buff *aqc111_tx_fixup(struct usbnet *dev, struct sk_buff *skb,
 	if (headroom != 0)
 		padding_size = 8 - headroom;
 
-	if (((skb->len + sizeof(tx_desc) + padding_size) % frame_size) == 0) {
+	if (last && ((offset + skb->len + sizeof(tx_desc) + padding_size) %
+		     frame_size) == 0) {
 		padding_size += 8;
 		tx_desc |= AQ_TX_DESC_DROP_PADD;
 	}
@@ -1533,17 +3228,14 @@ static struct sk_buff *aqc111_tx_fixup(struct usbnet *dev, struct sk_buff *skb,
 			   AQ_TX_DESC_VLAN_SHIFT;
 	}
 
-	if (
-#if KERNEL_VERSION(3, 12, 0) <= LINUX_VERSION_CODE || (RHEL_RELEASE_CODE)
-	    !dev->can_dma_sg &&
-#endif
-	    (dev->net->features & NETIF_F_SG) &&
-	    skb_linearize(skb))
-		return NULL;
-
 	headroom = skb_headroom(skb);
 	tailroom = skb_tailroom(skb);
 
+	if (padding_size != 0 && skb_is_nonlinear(skb) &&
+	    headroom >= sizeof(tx_desc) &&
+	    !aqc111_tx_pad_frags(skb, padding_size, flags))
+		padding_size = 0;
+
 	if (!(headroom >= sizeof(tx_desc) && tailroom >= padding_size)) {
 		new_skb = skb_copy_expand(skb, sizeof(tx_desc),
 					  padding_size, flags);
@@ -1559,6 +3251,98 @@ static struct sk_buff *aqc111_tx_fixup(struct usbnet *dev, struct sk_buff *skb,
 	cpu_to_le64s(&tx_desc);
 	skb_copy_to_linear_data(skb, &tx_desc, sizeof(tx_desc));
 
+	return skb;
+}
+
+#ifdef AQ_SW_GSO
+/* The MAC only segments plain TCP. UDP and tunnelled GSO packets are
+ * segmented here and go out as consecutive frames of one transfer,
+ * chained on frag_list for start_xmit() to map through scatter-gather.
+ * TXCOE cannot reach inner headers, so those are checksummed here too.
+ */
+static struct sk_buff *aqc111_tx_gso(struct usbnet *dev, struct sk_buff *skb,
+				     gfp_t flags)
+{
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	netdev_features_t features = dev->net->features & ~NETIF_F_GSO_MASK;
+	struct sk_buff *head = NULL;
+	struct sk_buff *tail = NULL;
+	struct sk_buff *segs;
+	struct sk_buff *next;
+	unsigned int packets = 0;
+	unsigned int len = 0;
+
+	if (skb->encapsulation)
+		features &= ~NETIF_F_CSUM_MASK;
+
+	segs = skb_gso_segment(skb, features);
+	if (IS_ERR_OR_NULL(segs)) {
+		dev_kfree_skb_any(skb);
+		return NULL;
+	}
+	dev_consume_skb_any(skb);
+
+	for (skb = segs; skb; skb = next) {
+		next = skb->next;
+		skb->next = NULL;
+
+		skb = aqc111_tx_frame(dev, skb, len, !next, flags);
+		if (!skb)
+			goto err;
+
+		len += skb->len;
+		packets++;
+
+		if (!head) {
+			head = skb;
+			continue;
+		}
+		if (tail)
+			tail->next = skb;
+		else
+			skb_shinfo(head)->frag_list = skb;
+		tail = skb;
+		head->len += skb->len;
+		head->data_len += skb->len;
+		head->truesize += skb->truesize;
+	}
+
+	if (!usbnet_can_dma_sg(dev) && skb_linearize(head)) {
+		dev_kfree_skb_any(head);
+		return NULL;
+	}
+
+	aqc111_data->stats.tx_gso_sw++;
+	aqc111_data->stats.tx_gso_sw_segs += packets;
+	usbnet_set_skb_tx_stats(head, packets, 0);
+
+	return head;
+
+err:
+	kfree_skb_list(next);
+	if (head)
+		dev_kfree_skb_any(head);
+	return NULL;
+}
+#endif
+
+static struct sk_buff *aqc111_tx_fixup(struct usbnet *dev, struct sk_buff *skb,
+				       gfp_t flags)
+{
+#ifdef AQ_SW_GSO
+	if (skb_is_gso(skb) &&
+	    (skb_shinfo(skb)->gso_type & AQ_SW_GSO_TYPES))
+		return aqc111_tx_gso(dev, skb, flags);
+#endif
+
+	if (!usbnet_can_dma_sg(dev) && (dev->net->features & NETIF_F_SG) &&
+	    skb_linearize(skb))
+		return NULL;
+
+	skb = aqc111_tx_frame(dev, skb, 0, true, flags);
+	if (!skb)
+		return NULL;
+
 	usbnet_set_skb_tx_stats(skb, 1, 0);
 
 	return skb;
@@ -1576,6 +3360,7 @@ static const struct driver_info aqc111_info = {
 			  FLAG_AVOID_UNLINK_URBS | FLAG_MULTI_PACKET,
 	.rx_fixup	= aqc111_rx_fixup,
 	.tx_fixup	= aqc111_tx_fixup,
+	.manage_power	= aqc111_manage_power,
 };
 
 #define ASIX111_DESC \
@@ -1593,6 +3378,7 @@ static const struct driver_info asix111_info = {
 			  FLAG_AVOID_UNLINK_URBS | FLAG_MULTI_PACKET,
 	.rx_fixup	= aqc111_rx_fixup,
 	.tx_fixup	= aqc111_tx_fixup,
+	.manage_power	= aqc111_manage_power,
 };
 
 #undef ASIX111_DESC
@@ -1612,6 +3398,7 @@ static const struct driver_info asix112_info = {
 			  FLAG_AVOID_UNLINK_URBS | FLAG_MULTI_PACKET,
 	.rx_fixup	= aqc111_rx_fixup,
 	.tx_fixup	= aqc111_tx_fixup,
+	.manage_power	= aqc111_manage_power,
 };
 
 #undef ASIX112_DESC
@@ -1628,6 +3415,7 @@ static const struct driver_info trendnet_info = {
 			  FLAG_AVOID_UNLINK_URBS | FLAG_MULTI_PACKET,
 	.rx_fixup	= aqc111_rx_fixup,
 	.tx_fixup	= aqc111_tx_fixup,
+	.manage_power	= aqc111_manage_power,
 };
 
 static const struct driver_info qnap_info = {
@@ -1642,18 +3430,45 @@ static const struct driver_info qnap_info = {
 			  FLAG_AVOID_UNLINK_URBS | FLAG_MULTI_PACKET,
 	.rx_fixup	= aqc111_rx_fixup,
 	.tx_fixup	= aqc111_tx_fixup,
+	.manage_power	= aqc111_manage_power,
 };
 
 static int aqc111_suspend(struct usb_interface *intf, pm_message_t message)
 {
 	struct usbnet *dev = usb_get_intfdata(intf);
 	struct aqc111_data *aqc111_data = dev->driver_priv;
+	bool autosuspend = PMSG_IS_AUTO(message);
+	u8 wol_flags = aqc111_data->wol_flags;
 	u16 temp_rx_ctrl = 0x00;
 	u16 reg16;
 	u8 reg8;
+	int ret;
 
-	usbnet_suspend(intf, message);
+	ret = usbnet_suspend(intf, message);
+	if (ret < 0)
+		return ret;
+
+	aqc111_phy_work_cancel(dev);
+	aqc111_data->resume_event = ktime_set(0, 0);
+
+	/* An open interface must be woken by the network: magic packet and,
+	 * with direct PHY access, a link change. The PHY keeps its link.
+	 * A closed one suspends like for system sleep.
+	 */
+	if (autosuspend && !netif_running(dev->net))
+		autosuspend = false;
+	if (autosuspend) {
+		wol_flags |= AQ_WOL_FLAG_MP;
+		aqc111_data->stats.pm_autosuspend++;
+	}
+	aqc111_data->autosuspended = autosuspend && aqc111_data->dpa;
 
+	/* Arming WoL reprograms bulk-in, DMA and monitor mode */
+	if (wol_flags)
+		aqc111_data->mac_ready = false;
+
+	aqc111_read16_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
+			       2, &aqc111_data->medium);
 	aqc111_read16_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_RX_CTL, 2, &reg16);
 	temp_rx_ctrl = reg16;
 	/* Stop RX operations*/
@@ -1679,19 +3494,21 @@ static int aqc111_suspend(struct usb_interface *intf, pm_message_t message)
 	aqc111_write_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_ETH_MAC_PATH,
 			      1, 1, &reg8);
 
-	if (aqc111_data->wol_flags) {
+	if (wol_flags) {
 		struct aqc111_wol_cfg wol_cfg = { 0 };
 
 		aqc111_data->phy_cfg |= AQ_WOL;
 		if (aqc111_data->dpa) {
 			reg8 = 0;
-			if (aqc111_data->wol_flags & AQ_WOL_FLAG_MP)
+			if (wol_flags & AQ_WOL_FLAG_MP)
 				reg8 |= SFR_MONITOR_MODE_RWMP;
+			if (autosuspend)
+				reg8 |= SFR_MONITOR_MODE_RWLC;
 			aqc111_write_cmd_nopm(dev, AQ_ACCESS_MAC,
 					      SFR_MONITOR_MODE, 1, 1, &reg8);
 		} else {
 			ether_addr_copy(wol_cfg.hw_addr, dev->net->dev_addr);
-			wol_cfg.flags = aqc111_data->wol_flags;
+			wol_cfg.flags = wol_flags;
 		}
 
 		temp_rx_ctrl |= (SFR_RX_CTL_AB | SFR_RX_CTL_START);
@@ -1720,35 +3537,35 @@ static int aqc111_suspend(struct usb_interface *intf, pm_message_t message)
 		aqc111_write_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_RX_BULKIN_QIFG,
 				      1, 1, &reg8);
 
-		aqc111_read16_cmd_nopm(dev, AQ_ACCESS_MAC,
-				       SFR_MEDIUM_STATUS_MODE, 2, &reg16);
-		reg16 |= SFR_MEDIUM_RECEIVE_EN;
+		reg16 = aqc111_data->medium | SFR_MEDIUM_RECEIVE_EN;
 		aqc111_write16_cmd_nopm(dev, AQ_ACCESS_MAC,
 					SFR_MEDIUM_STATUS_MODE, 2, &reg16);
 
+		/* Runtime PM must not be re-entered from here */
 		if (aqc111_data->dpa) {
-			aqc111_set_phy_speed(dev, AUTONEG_ENABLE, SPEED_100);
+			if (!autosuspend)
+				aqc111_set_phy_speed(dev, AUTONEG_ENABLE,
+						     SPEED_100);
 		} else {
-			aqc111_write_cmd(dev, AQ_WOL_CFG, 0, 0,
-					 WOL_CFG_SIZE, &wol_cfg);
-			aqc111_write32_cmd(dev, AQ_PHY_OPS, 0, 0,
-					   &aqc111_data->phy_cfg);
+			aqc111_write_cmd_nopm(dev, AQ_WOL_CFG, 0, 0,
+					      WOL_CFG_SIZE, &wol_cfg);
+			aqc111_write32_cmd_nopm(dev, AQ_PHY_OPS, 0, 0,
+						&aqc111_data->phy_cfg);
 		}
 	} else {
 		aqc111_data->phy_cfg |= AQ_LOW_POWER;
 		if (!aqc111_data->dpa) {
-			aqc111_write32_cmd(dev, AQ_PHY_OPS, 0, 0,
-					   &aqc111_data->phy_cfg);
+			aqc111_write32_cmd_nopm(dev, AQ_PHY_OPS, 0, 0,
+						&aqc111_data->phy_cfg);
 		} else {
 			reg16 = AQ_PHY_LOW_POWER_MODE;
-			aqc111_mdio_write(dev, AQ_GLB_STD_CTRL_REG,
-					  AQ_PHY_GLOBAL_ADDR, &reg16);
+			aqc111_write16_cmd_nopm(dev, AQ_PHY_CMD,
+						AQ_GLB_STD_CTRL_REG,
+						AQ_PHY_GLOBAL_ADDR, &reg16);
 		}
 
 		/* Disable RX path */
-		aqc111_read16_cmd_nopm(dev, AQ_ACCESS_MAC,
-				       SFR_MEDIUM_STATUS_MODE, 2, &reg16);
-		reg16 &= ~SFR_MEDIUM_RECEIVE_EN;
+		reg16 = aqc111_data->medium & ~SFR_MEDIUM_RECEIVE_EN;
 		aqc111_write16_cmd_nopm(dev, AQ_ACCESS_MAC,
 					SFR_MEDIUM_STATUS_MODE, 2, &reg16);
 	}
@@ -1756,61 +3573,93 @@ static int aqc111_suspend(struct usb_interface *intf, pm_message_t message)
 	return 0;
 }
 
-static int aqc111_resume(struct usb_interface *intf)
+/* Restore the MAC from the state saved on suspend. The writes are queued
+ * back to back on the control pipe instead of waiting for each of them.
+ */
+static void aqc111_resume_mac(struct usbnet *dev)
 {
-	struct usbnet *dev = usb_get_intfdata(intf);
 	struct aqc111_data *aqc111_data = dev->driver_priv;
 	u16 reg16;
 	u8 reg8;
 
-	netif_carrier_off(dev->net);
-
-	/* Power up ethernet PHY */
-	aqc111_data->phy_cfg |= AQ_PHY_POWER_EN;
-	aqc111_data->phy_cfg &= ~AQ_LOW_POWER;
-	aqc111_data->phy_cfg &= ~AQ_WOL;
-	if (aqc111_data->dpa) {
-		aqc111_read_cmd_nopm(dev, AQ_PHY_POWER, 0, 0, 1, &reg8);
-		if (reg8 == 0x00) {
-			reg8 = 0x02;
-			aqc111_write_cmd_nopm(dev, AQ_PHY_POWER, 0, 0,
-					      1, &reg8);
-			msleep(200);
-		}
-
-		aqc111_mdio_read(dev, AQ_GLB_STD_CTRL_REG, AQ_PHY_GLOBAL_ADDR,
-				 &reg16);
-		if (reg16 & AQ_PHY_LOW_POWER_MODE) {
-			reg16 &= ~AQ_PHY_LOW_POWER_MODE;
-			aqc111_mdio_write(dev, AQ_GLB_STD_CTRL_REG,
-					  AQ_PHY_GLOBAL_ADDR, &reg16);
-		}
-	}
-
 	reg8 = 0xFF;
-	aqc111_write_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_BM_INT_MASK,
-			      1, 1, &reg8);
+	aqc111_write_cmd_async(dev, AQ_ACCESS_MAC, SFR_BM_INT_MASK,
+			       1, 1, &reg8);
 	/* Configure RX control register => start operation */
-	reg16 = aqc111_data->rxctl;
-	reg16 &= ~SFR_RX_CTL_START;
-	aqc111_write16_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_RX_CTL, 2, &reg16);
+	reg16 = aqc111_data->rxctl & ~SFR_RX_CTL_START;
+	aqc111_write16_cmd_async(dev, AQ_ACCESS_MAC, SFR_RX_CTL, 2, &reg16);
 
 	reg16 |= SFR_RX_CTL_START;
-	aqc111_write16_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_RX_CTL, 2, &reg16);
-
-	aqc111_set_phy_speed(dev, aqc111_data->autoneg,
-			     aqc111_data->advertised_speed);
+	aqc111_write16_cmd_async(dev, AQ_ACCESS_MAC, SFR_RX_CTL, 2, &reg16);
 
-	aqc111_read16_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
-			       2, &reg16);
-	reg16 |= SFR_MEDIUM_RECEIVE_EN;
-	aqc111_write16_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
-				2, &reg16);
+	reg16 = aqc111_data->medium | SFR_MEDIUM_RECEIVE_EN;
+	aqc111_write16_cmd_async(dev, AQ_ACCESS_MAC, SFR_MEDIUM_STATUS_MODE,
+				 2, &reg16);
 	reg8 = SFR_RX_PATH_READY;
-	aqc111_write_cmd_nopm(dev, AQ_ACCESS_MAC, SFR_ETH_MAC_PATH,
-			      1, 1, &reg8);
+	aqc111_write_cmd_async(dev, AQ_ACCESS_MAC, SFR_ETH_MAC_PATH,
+			       1, 1, &reg8);
 	reg8 = 0x0;
-	aqc111_write_cmd(dev, AQ_ACCESS_MAC, SFR_BMRX_DMA_CONTROL, 1, 1, &reg8);
+	aqc111_write_cmd_async(dev, AQ_ACCESS_MAC, SFR_BMRX_DMA_CONTROL,
+			       1, 1, &reg8);
+}
+
+/* The PHY kept its link, only the MAC has to be brought back */
+static int aqc111_autoresume(struct usb_interface *intf)
+{
+	struct usbnet *dev = usb_get_intfdata(intf);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+	struct aqc111_stats *stats = &aqc111_data->stats;
+	ktime_t start = ktime_get();
+	int ret;
+	s64 us;
+	u8 reg8;
+
+	aqc111_data->autosuspended = false;
+	aqc111_data->phy_cfg &= ~AQ_WOL;
+
+	reg8 = 0;
+	aqc111_write_cmd_async(dev, AQ_ACCESS_MAC, SFR_MONITOR_MODE,
+			       1, 1, &reg8);
+	aqc111_resume_mac(dev);
+	ret = usbnet_resume(intf);
+
+	/* Bulk-in and DMA setup were replaced by the WoL configuration */
+	if (netif_carrier_ok(dev->net))
+		usbnet_defer_kevent(dev, EVENT_LINK_RESET);
+
+	us = ktime_us_delta(ktime_get(), start);
+	stats->pm_autoresume++;
+	stats->pm_wake_last_us = us;
+	if (us > stats->pm_wake_max_us)
+		stats->pm_wake_max_us = us;
+
+	return ret;
+}
+
+static int aqc111_resume(struct usb_interface *intf)
+{
+	struct usbnet *dev = usb_get_intfdata(intf);
+	struct aqc111_data *aqc111_data = dev->driver_priv;
+
+	if (aqc111_data->autosuspended)
+		return aqc111_autoresume(intf);
+
+	netif_carrier_off(dev->net);
+	aqc111_data->resume_event = ktime_get();
+
+	aqc111_data->phy_cfg |= AQ_PHY_POWER_EN;
+	aqc111_data->phy_cfg &= ~AQ_LOW_POWER;
+	aqc111_data->phy_cfg &= ~AQ_WOL;
+
+	aqc111_resume_mac(dev);
+
+	/* Powering the PHY may sleep 200ms, autoneg then reports the link
+	 * through the interrupt endpoint that usbnet_resume() restarts.
+	 * The work keeps the device from autosuspending until it ran.
+	 */
+	usb_autopm_get_interface_no_resume(intf);
+	if (!schedule_delayed_work(&aqc111_data->phy_work, 0))
+		usb_autopm_put_interface_no_suspend(intf);
 
 	return usbnet_resume(intf);
 }
@@ -1843,6 +3692,7 @@ static struct usb_driver aq_driver = {
 	.suspend	= aqc111_suspend,
 	.resume		= aqc111_resume,
 	.disconnect	= usbnet_disconnect,
+	.supports_autosuspend = 1,
 };
 
 module_usb_driver(aq_driver);
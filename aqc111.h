@@ -42,12 +42,22 @@
 	#define AQ_ANEG_ASYM_PAUSE		0x0800
 	#define AQ_ANEG_ABILITY_MASK		0x0FE0
 
+#define AQ_AUTONEG_LP_REG		0x0013
+
 #define AQ_AUTONEG_10GT_CTRL_REG	0x0020
 	#define AQ_ANEG_ADV_10G_T		0x1000
 	#define AQ_ANEG_ADV_5G_T		0x0100
 	#define AQ_ANEG_ADV_2G5_T		0x0080
 	#define AQ_ANEG_ADV_LT			0x0001
 
+#define AQ_AUTONEG_EEE_ADV_REG		0x003C
+#define AQ_AUTONEG_EEE_LP_REG		0x003D
+	#define AQ_EEE_1G			0x0004
+#define AQ_AUTONEG_EEE_ADV2_REG		0x003E
+#define AQ_AUTONEG_EEE_LP2_REG		0x003F
+	#define AQ_EEE2_2G5			0x0001
+	#define AQ_EEE2_5G			0x0002
+
 #define AQ_AUTONEG_VEN_PROV1_REG	0xC400
 	#define AQ_ANEG_ADV_1G			0x8000
 	#define AQ_ANEG_ADV_AQRATE		0x1000
@@ -57,6 +67,14 @@
 	#define AQ_ANEG_EN_DSH			0x0010
 	#define AQ_ANEG_DSH_RETRY		0x0003
 
+#define AQ_PHY_PCS_MMD			0x03
+#define AQ_PHY_PCS_ADDR			AQ_PHY_ADDR(AQ_PHY_PCS_MMD)
+
+#define AQ_PCS_STAT1_REG		0x0001
+	#define AQ_PCS_RX_LPI			0x0100
+	#define AQ_PCS_TX_LPI			0x0200
+#define AQ_PCS_EEE_WAKE_ERR_REG		0x0016
+
 #define AQ_PHY_GLOBAL_MMD		0x1E
 #define AQ_PHY_GLOBAL_ADDR		AQ_PHY_ADDR(AQ_PHY_GLOBAL_MMD)
 
@@ -71,30 +89,62 @@
 #define AQ_GLB_ING_PAUSE_CTRL_REG	0x7148
 #define AQ_GLB_EGR_PAUSE_CTRL_REG	0x4148
 
+#define AQ_GLB_THERMAL_STAT1_REG	0xC820
+#define AQ_GLB_THERMAL_STAT2_REG	0xC821
+	#define AQ_THERMAL_READY		0x0001
+
 #define AQ_USB_PHY_SET_TIMEOUT		10000
 #define AQ_USB_SET_TIMEOUT		4000
 
 #define AQ_THERMAL_TIMER_MS		500
+#define AQ_PHY_WORK_RETRY_MS		10
+#define AQ_THERMAL_MIN_TIMER_MS		100
+#define AQ_THERMAL_MAX_TIMER_MS		60000
 /* Temperature thresholds in units degree of Celsius */
 #define AQ_NORMAL_TEMP_THRESHOLD	85
 #define AQ_HIGH_TEMP_THRESHOLD		106
 #define AQ_CRITICAL_TEMP_THRESHOLD	108
 
+/* Driver throttling steps, each one entered at its own temperature */
+#define AQ_THERMAL_STEP_XFI_DIV_2	1
+#define AQ_THERMAL_STEP_2G5		2
+#define AQ_THERMAL_STEP_1G		3
+#define AQ_THERMAL_STEP_100M		4
+#define AQ_THERMAL_STEPS		4
+#define AQ_THERMAL_HYSTERESIS		5
+#define AQ_THERMAL_MAX_HYSTERESIS	20
+
+/* Link load (percent of link speed) that lets the steps above 100M
+ * engage, and below which they are released again
+ */
+#define AQ_GOV_BUSY_LOAD		50
+#define AQ_GOV_IDLE_LOAD		5
+#define AQ_GOV_SUSTAIN_MS		5000
+#define AQ_GOV_MAX_SUSTAIN_MS		600000
+
 #define AQ_SW_CONFIG_MAGIC_KEY		0xABBA
 #define AQ_SW_CONFIG_LAN		0x0001
 /* Feature. ********************************************/
 #define AQ_SUPPORT_FEATURE	(NETIF_F_SG | NETIF_F_IP_CSUM |\
 				 NETIF_F_IPV6_CSUM | NETIF_F_RXCSUM |\
 				 NETIF_F_TSO | NETIF_F_HW_VLAN_CTAG_TX |\
-				 NETIF_F_HW_VLAN_CTAG_RX)
+				 NETIF_F_HW_VLAN_CTAG_RX | AQ_SW_GSO_FEATURE)
 
 #define AQ_SUPPORT_HW_FEATURE	(NETIF_F_SG | NETIF_F_IP_CSUM |\
 				 NETIF_F_IPV6_CSUM | NETIF_F_RXCSUM |\
-				 NETIF_F_TSO | NETIF_F_HW_VLAN_CTAG_FILTER)
+				 NETIF_F_TSO | NETIF_F_HW_VLAN_CTAG_FILTER |\
+				 NETIF_F_LRO | AQ_SW_GSO_FEATURE)
 
 #define AQ_SUPPORT_VLAN_FEATURE (NETIF_F_SG | NETIF_F_IP_CSUM |\
 				 NETIF_F_IPV6_CSUM | NETIF_F_RXCSUM |\
-				 NETIF_F_TSO)
+				 NETIF_F_TSO | AQ_SW_GSO_FEATURE)
+
+/* Checksums are only offloaded for the outer headers, see
+ * aqc111_features_check()
+ */
+#define AQ_SUPPORT_ENC_FEATURE	(NETIF_F_SG | NETIF_F_IP_CSUM |\
+				 NETIF_F_IPV6_CSUM | NETIF_F_TSO |\
+				 AQ_SW_GSO_FEATURE)
 
 /* DC Reg. *********************************************/
 #define DC_SS_CTL			0x310
@@ -185,13 +235,23 @@
 	#define SFR_BULK_OUT_FLUSH_EN		0x01
 	#define SFR_BULK_OUT_EFF_EN		0x02
 
+/* ethtool register dump: MAC SFR blocks, the PHY_OPS word and, with
+ * direct PHY access, the PHY MMD registers as little endian u16
+ */
+#define AQ_REGS_VERSION			1
+
 #define AQ_FW_VER_MAJOR			0xDA
 #define AQ_FW_VER_MINOR			0xDB
 #define AQ_FW_VER_REV			0xDC
 
-#define AQ_PRIV_FLAGS_MASK		0x3
+#define AQ_PRIV_FLAGS_MASK		0xF
 #define AQ_PF_XFI_DIV_2			BIT(0)
 #define AQ_PF_THERMAL			BIT(1)
+#define AQ_PF_AUTOSUSPEND		BIT(2)
+#define AQ_PF_BIG_TSO			BIT(3)
+
+/* Idle time before autosuspend, set when the private flag is enabled */
+#define AQ_AUTOSUSPEND_DELAY_MS		30000
 
 /*PHY_OPS**********************************************************************/
 
@@ -201,6 +261,9 @@
 #define AQ_ADV_5G	BIT(3)
 #define AQ_ADV_MASK	0x0F
 
+/* Speeds the PHY supports EEE at, as AQ_ADV_* bits */
+#define AQ_EEE_SUPPORTED	(AQ_ADV_1G | AQ_ADV_2G5 | AQ_ADV_5G)
+
 #define AQ_PAUSE	BIT(16)
 #define AQ_ASYM_PAUSE	BIT(17)
 #define AQ_LOW_POWER	BIT(18)
@@ -232,7 +295,52 @@ struct aqc111_thermal_params {
 
 #define WOL_CFG_SIZE sizeof(struct aqc111_wol_cfg)
 
+/* Driver statistics exported through ethtool -S, keep in sync with
+ * aqc111_gstrings_stats
+ */
+struct aqc111_stats {
+	u64 rx_copy;
+	u64 rx_clone;
+	u64 rx_lro_merged;
+	u64 rx_lro_flushed;
+	u64 rx_csum_ok;
+	u64 rx_csum_err;
+	u64 rx_csum_none;
+	u64 rx_pd_drop;
+	u64 rx_wl_raise;
+	u64 rx_wl_lower;
+	u64 link_up_full;
+	u64 link_up_fast;
+	u64 link_up_last_us;
+	u64 link_up_max_us;
+	u64 link_down_last_us;
+	u64 link_down_max_us;
+	u64 resume_carrier_last_us;
+	u64 resume_carrier_max_us;
+	u64 pm_autosuspend;
+	u64 pm_autoresume;
+	u64 pm_wake_last_us;
+	u64 pm_wake_max_us;
+	u64 eee_rx_lpi_ms;
+	u64 eee_tx_lpi_ms;
+	u64 eee_wake_errors;
+	u64 tx_gso_sw;
+	u64 tx_gso_sw_segs;
+};
+
+/* Software LRO context, lives for one bulk-in transfer */
+struct aqc111_lro {
+	struct sk_buff *head;
+	struct sk_buff *tail;
+	u32 tcp_off;
+	u32 hdr_len;
+	u32 next_seq;
+	u16 mss;
+	u16 segs;
+};
+
 struct aqc111_data {
+	struct usbnet *dev;
 	u16 rxctl;
 	u8 rx_checksum;
 	u8 link_speed;
@@ -246,8 +354,50 @@ struct aqc111_data {
 	} fw_ver;
 	u8 dpa; /*direct PHY access*/
 	u32 phy_cfg;
+	bool eee_enabled;
+	u8 eee_adv; /* AQ_ADV_* speeds EEE is advertised at */
+	bool pause_autoneg;
+	bool rx_pause;
+	bool tx_pause;
+	bool mac_ready; /* link independent MAC setup is programmed */
+	ktime_t link_event; /* link up reported by the interrupt endpoint */
+	ktime_t link_down_event; /* carrier dropped ahead of link_reset() */
+	ktime_t resume_event;
+	u16 medium; /* SFR_MEDIUM_STATUS_MODE saved on suspend */
+	struct delayed_work phy_work;
+	bool pm_managed; /* usbnet allows runtime PM while open */
+	bool pm_hold; /* PM reference blocking autosuspend while open */
+	bool autosuspended; /* runtime suspended with the link kept */
 	u8 wol_flags;
 	u32 priv_flags;
+	u32 rx_copybreak;
+	struct aqc111_stats stats;
+	struct delayed_work thermal_work;
+	unsigned int thermal_interval; /* ms */
+	struct device *hwmon;
+	int temp; /* millidegree Celsius */
+	bool temp_valid;
+	u32 thermal_events;
+	u8 thermal_level;
+	u8 thermal_step[AQ_THERMAL_STEPS];
+	u8 thermal_hyst;
+	struct {
+		u64 drops;
+		u32 backlog;
+		u8 scale;
+		u8 calm;
+	} wl;
+	struct {
+		u64 rx_bytes;
+		u64 tx_bytes;
+		unsigned long stamp;
+		u32 busy_ms;
+		u32 idle_ms;
+		u32 sustain_ms;
+		u8 load;
+		u8 busy_load;
+		u8 idle_load;
+	} gov;
 };
 
 #define AQ_LS_MASK		0x8000
@@ -267,6 +417,25 @@ struct aqc111_data {
 #define AQ_TX_DESC_VLAN_MASK	0xFFFF
 #define AQ_TX_DESC_VLAN_SHIFT	0x30
 
+/* Largest TSO frame the length field describes, the stack clamps it to
+ * its own GSO_MAX_SIZE. Not verified on hardware, so only used with the
+ * "Big TSO" private flag.
+ */
+#define AQ_TSO_MAX_SIZE		AQ_TX_DESC_LEN_MASK
+#define AQ_TSO_LEGACY_SIZE	65535
+
+/* TX bands, the priority band is submitted ahead of queued bulk data */
+#define AQ_TX_BAND_PRIO		0
+#define AQ_TX_BAND_BULK		1
+#define AQ_TX_BANDS		2
+/* Bulk bytes in flight: this much wire time at the link speed, but
+ * at least two TSO frames so the pipe does not drain between them
+ */
+#define AQ_TX_BULK_US		1000
+#define AQ_TX_BULK_MIN		(2 * AQ_TSO_LEGACY_SIZE)
+/* DSCP CS5 and above (EF, CS6, CS7) take the priority band */
+#define AQ_TX_PRIO_DSCP		0x28
+
 #define AQ_RX_HW_PAD			0x02
 
 /* RX Packet Descriptor */
@@ -286,6 +455,22 @@ struct aqc111_data {
 #define AQ_RX_PD_LEN_SHIFT	0x10
 #define AQ_RX_PD_VLAN_SHIFT	0x20
 
+/* Pause water levels are scaled in eighths of the MTU based setting:
+ * raised on RX drops or a usbnet_bh backlog, lowered after calm polls
+ */
+#define AQ_WL_SCALE_BASE	8
+#define AQ_WL_SCALE_MIN		4
+#define AQ_WL_SCALE_MAX		16
+#define AQ_WL_BACKLOG_HIGH	8
+#define AQ_WL_BACKLOG_LOW	1
+#define AQ_WL_CALM_POLLS	10
+
+/* Max IP datagram built by software LRO */
+#define AQ_LRO_MAX_SIZE		0xFFFF
+
+/* Frames up to this length are copied, longer ones are cloned */
+#define AQ_RX_COPYBREAK_MAX	(AQ_RX_PD_LEN_MASK >> AQ_RX_PD_LEN_SHIFT)
+
 /* RX Descriptor header */
 #define AQ_RX_DH_PKT_CNT_MASK		0x1FFF
 #define AQ_RX_DH_DESC_OFFSET_MASK	0xFFFFE000
@@ -1,20 +1,8 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
 /*
  * USB Network driver infrastructure
  * Copyright (C) 2000-2005 by David Brownell
  * Copyright (C) 2003-2005 David Hollis <dhollis@davehollis.com>
- *
- * This program is free software; you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation; either version 2 of the License, or
- * (at your option) any later version.
- *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
 /*
@@ -32,6 +20,7 @@
 // #define	DEBUG			// error path messages, extra info
 // #define	VERBOSE			// more; success messages
 
+#include <linux/version.h>
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/netdevice.h>
@@ -42,13 +31,15 @@
 #include <linux/mii.h>
 #include <linux/usb.h>
 #include <linux/usb/usbnet.h>
+#if KERNEL_VERSION(4, 4, 0) <= LINUX_VERSION_CODE && \
+    KERNEL_VERSION(4, 9, 0) > LINUX_VERSION_CODE
 #include <linux/usb/cdc.h>
+#endif
 #include <linux/slab.h>
 #include <linux/kernel.h>
 #include <linux/pm_runtime.h>
 
-#define DRIVER_VERSION		"22-Aug-2005"
-
+#include "usbnet_ext.h"
 
 /*-------------------------------------------------------------------------*/
 
@@ -64,8 +55,10 @@
  * the equation.
  */
 #define	MAX_QUEUE_MEMORY	(60 * 1518)
-#define	RX_QLEN(dev)		((dev)->rx_qlen)
-#define	TX_QLEN(dev)		((dev)->tx_qlen)
+#define	RX_QLEN(dev)		usbnet_field(dev, rx_qlen)
+#define	TX_QLEN(dev)		usbnet_field(dev, tx_qlen)
+/* a full TX queue restarts once it drained to this, see tx_complete() */
+#define	TX_WAKE_QLEN(dev)	(TX_QLEN(dev) * 3 / 4)
 
 // reawaken network queue this soon after stopping; else watchdog barks
 #define TX_TIMEOUT_JIFFIES	(5*HZ)
@@ -78,13 +71,367 @@
 // between wakeups
 #define UNLINK_TIMEOUT_MS	3
 
+/* RX buffers set aside in process context for atomic refill failures */
+#define RX_RESERVE		4
+
+/* usbnet_ext flags */
+#define EXT_NAPI_ON		0	/* NAPI reaps dev->done */
+#define EXT_RX_REFILL		1	/* keventd refills rx_reserve */
+
+/*-------------------------------------------------------------------------*/
+
+/* hot path counters, one set per CPU, folded in usbnet_get_stats64() */
+struct usbnet_pcpu_stats {
+	u64			rx_packets;
+	u64			rx_bytes;
+	u64			rx_dropped;
+	u64			tx_packets;
+	u64			tx_bytes;
+	u64			tx_dropped;
+	struct u64_stats_sync	syncp;
+};
+
+/* state this usbnet build keeps beyond the kernel's struct usbnet;
+ * netdev_priv() holds it with struct usbnet first.
+ */
+struct usbnet_ext {
+	struct usbnet		dev;
+
+	/* TX bands, one netdev TX queue each */
+	unsigned int		tx_bands;
+	unsigned int		tx_band_limit[USBNET_MAX_TX_BANDS];
+	atomic_t		tx_band_bytes[USBNET_MAX_TX_BANDS];
+
+	/* completed TX URBs kept for reuse */
+	struct usb_anchor	tx_urb_pool;
+	atomic_t		tx_urb_idle;
+	atomic64_t		tx_urb_alloc;
+	atomic64_t		tx_urb_reuse;
+	atomic64_t		tx_queue_stop;
+
+	/* RX buffers to fall back on when an atomic allocation fails */
+	struct sk_buff_head	rx_reserve;
+	atomic64_t		rx_reserve_used;
+	atomic64_t		rx_alloc_failed;
+
+	struct usbnet_pcpu_stats __percpu *stats;
+
+	/* completions are reaped by NAPI while open, so busy polling
+	 * sockets can run rx_fixup() from their own context
+	 */
+	struct napi_struct	napi;
+	unsigned long		flags;
+
+#ifdef USBNET_EXT_LEGACY
+	/* struct usbnet has all of these from 3.14 */
+	size_t			rx_qlen, tx_qlen;
+	unsigned		can_dma_sg:1;
+	void			*padding_pkt;
+#endif
+};
+
+/* rx_fixup() hands frames back through usbnet_skb_return(), which can't
+ * take the NAPI context, so rx_process() leaves it here for this CPU.
+ */
+struct usbnet_rx_ctx {
+	struct usbnet		*dev;
+	struct napi_struct	*napi;
+	int			work;		/* frames passed up */
+};
+
+static DEFINE_PER_CPU(struct usbnet_rx_ctx, usbnet_rx_ctx);
+
+static inline struct usbnet_ext *usbnet_ext(struct usbnet *dev)
+{
+	return container_of(dev, struct usbnet_ext, dev);
+}
+
+#ifdef USBNET_EXT_LEGACY
+#define usbnet_field(dev, f)	(usbnet_ext(dev)->f)
+#else
+#define usbnet_field(dev, f)	((dev)->f)
+#endif
+
+/* compat for the kernels this one source builds for, 3.10 to 5.10 */
+#ifdef USBNET_EXT_LEGACY
+static inline bool usb_device_no_sg_constraint(struct usb_device *udev)
+{
+	/* only xHCI runs SuperSpeed here, and it takes any SG layout */
+	return udev->bus->sg_tablesize && udev->speed == USB_SPEED_SUPER;
+}
+#endif
+
+#if KERNEL_VERSION(4, 7, 0) > LINUX_VERSION_CODE
+#define netif_trans_update(net)	((net)->trans_start = jiffies)
+#endif
+
+#if KERNEL_VERSION(5, 4, 0) > LINUX_VERSION_CODE
+#define skb_frag_off(f)		((f)->page_offset)
+#endif
+
+#ifndef sizeof_field
+#define sizeof_field(t, m)	FIELD_SIZEOF(t, m)
+#endif
+
+#ifndef NAPI_POLL_WEIGHT
+#define NAPI_POLL_WEIGHT	64
+#endif
+
+#if KERNEL_VERSION(3, 15, 0) > LINUX_VERSION_CODE
+#define u64_stats_fetch_begin_irq	u64_stats_fetch_begin_bh
+#define u64_stats_fetch_retry_irq	u64_stats_fetch_retry_bh
+#elif KERNEL_VERSION(6, 3, 0) <= LINUX_VERSION_CODE
+#define u64_stats_fetch_begin_irq	u64_stats_fetch_begin
+#define u64_stats_fetch_retry_irq	u64_stats_fetch_retry
+#endif
+
+#if KERNEL_VERSION(4, 3, 0) > LINUX_VERSION_CODE
+#define strscpy(d, s, n)	strlcpy(d, s, n)
+#endif
+
+/* dev_addr is read only from 5.17 */
+static inline void usbnet_set_hw_addr(struct net_device *net, const u8 *addr)
+{
+#if KERNEL_VERSION(5, 15, 0) <= LINUX_VERSION_CODE
+	eth_hw_addr_set(net, addr);
+#else
+	memcpy(net->dev_addr, addr, ETH_ALEN);
+#endif
+}
+
+/* TX completes in hard irq context on some kernels, so 32-bit SMP
+ * writers keep irqs off like u64_stats_update_begin_irqsave() does.
+ */
+static inline unsigned long usbnet_stats_begin(struct usbnet_pcpu_stats *s)
+{
+	unsigned long flags = 0;
+
+#if KERNEL_VERSION(4, 20, 0) <= LINUX_VERSION_CODE
+	flags = u64_stats_update_begin_irqsave(&s->syncp);
+#else
+#if BITS_PER_LONG == 32 && defined(CONFIG_SMP)
+	local_irq_save(flags);
+#endif
+	u64_stats_update_begin(&s->syncp);
+#endif
+	return flags;
+}
+
+static inline void usbnet_stats_end(struct usbnet_pcpu_stats *s,
+				    unsigned long flags)
+{
+#if KERNEL_VERSION(4, 20, 0) <= LINUX_VERSION_CODE
+	u64_stats_update_end_irqrestore(&s->syncp, flags);
+#else
+	u64_stats_update_end(&s->syncp);
+#if BITS_PER_LONG == 32 && defined(CONFIG_SMP)
+	local_irq_restore(flags);
+#endif
+#endif
+}
+
+static void usbnet_count_stats(struct usbnet *dev, bool tx,
+			       unsigned long packets, unsigned long bytes)
+{
+	struct usbnet_pcpu_stats *s = this_cpu_ptr(usbnet_ext(dev)->stats);
+	unsigned long flags;
+
+	flags = usbnet_stats_begin(s);
+	if (tx) {
+		s->tx_packets += packets;
+		s->tx_bytes += bytes;
+	} else {
+		s->rx_packets += packets;
+		s->rx_bytes += bytes;
+	}
+	usbnet_stats_end(s, flags);
+}
+
+static void usbnet_count_dropped(struct usbnet *dev, bool tx)
+{
+	struct usbnet_pcpu_stats *s = this_cpu_ptr(usbnet_ext(dev)->stats);
+	unsigned long flags;
+
+	flags = usbnet_stats_begin(s);
+	if (tx)
+		s->tx_dropped++;
+	else
+		s->rx_dropped++;
+	usbnet_stats_end(s, flags);
+}
+
+void usbnet_rx_dropped(struct usbnet *dev)
+{
+	usbnet_count_dropped(dev, false);
+}
+EXPORT_SYMBOL_GPL(usbnet_rx_dropped);
+
+static void usbnet_fold_stats(struct usbnet *dev,
+			      struct rtnl_link_stats64 *stats)
+{
+	int cpu;
+
+	netdev_stats_to_stats64(stats, &dev->net->stats);
+	for_each_possible_cpu(cpu) {
+		struct usbnet_pcpu_stats *s;
+		u64 rx_packets, rx_bytes, rx_dropped;
+		u64 tx_packets, tx_bytes, tx_dropped;
+		unsigned int start;
+
+		s = per_cpu_ptr(usbnet_ext(dev)->stats, cpu);
+		do {
+			start = u64_stats_fetch_begin_irq(&s->syncp);
+			rx_packets = s->rx_packets;
+			rx_bytes = s->rx_bytes;
+			rx_dropped = s->rx_dropped;
+			tx_packets = s->tx_packets;
+			tx_bytes = s->tx_bytes;
+			tx_dropped = s->tx_dropped;
+		} while (u64_stats_fetch_retry_irq(&s->syncp, start));
+
+		stats->rx_packets += rx_packets;
+		stats->rx_bytes += rx_bytes;
+		stats->rx_dropped += rx_dropped;
+		stats->tx_packets += tx_packets;
+		stats->tx_bytes += tx_bytes;
+		stats->tx_dropped += tx_dropped;
+	}
+}
+
+/* a band stops once its own in-flight bytes or the shared URB queue
+ * are full, so a stalled bulk band never holds back the others.
+ */
+static bool usbnet_tx_band_full(struct usbnet *dev, u16 band)
+{
+	struct usbnet_ext *ext = usbnet_ext(dev);
+
+	if (dev->txq.qlen >= TX_QLEN(dev))
+		return true;
+	return ext->tx_band_limit[band] &&
+	       atomic_read(&ext->tx_band_bytes[band]) >=
+	       ext->tx_band_limit[band];
+}
+
+static void usbnet_tx_band_add(struct usbnet *dev, struct sk_buff *skb,
+			       int bytes)
+{
+	u16 band = skb_get_queue_mapping(skb);
+
+	atomic_add(bytes, &usbnet_ext(dev)->tx_band_bytes[band]);
+}
+
+/* waking needs a quarter of the queue or of the band limit free, so
+ * a stopped band does not flap on every completion.
+ */
+static bool usbnet_tx_band_wakeable(struct usbnet *dev, u16 band)
+{
+	struct usbnet_ext *ext = usbnet_ext(dev);
+	unsigned int limit = ext->tx_band_limit[band];
+
+	if (dev->txq.qlen > TX_WAKE_QLEN(dev))
+		return false;
+	return !limit ||
+	       atomic_read(&ext->tx_band_bytes[band]) <= limit - limit / 4;
+}
+
+static void usbnet_tx_wake(struct usbnet *dev)
+{
+	u16 band;
+
+	for (band = 0; band < usbnet_ext(dev)->tx_bands; band++)
+		if (__netif_subqueue_stopped(dev->net, band) &&
+		    usbnet_tx_band_wakeable(dev, band))
+			netif_wake_subqueue(dev->net, band);
+}
+
+/* the HCD may still hold a reference to a URB handed back by
+ * tx_complete(), so a pooled URB is refilled rather than reinitialised.
+ */
+static struct urb *usbnet_tx_urb_get(struct usbnet *dev)
+{
+	struct usbnet_ext *ext = usbnet_ext(dev);
+	struct urb *urb;
+
+	urb = usb_get_from_anchor(&ext->tx_urb_pool);
+	if (urb) {
+		atomic_dec(&ext->tx_urb_idle);
+		atomic64_inc(&ext->tx_urb_reuse);
+		urb->transfer_flags = 0;
+		urb->num_sgs = 0;
+		return urb;
+	}
+
+	urb = usb_alloc_urb(0, GFP_ATOMIC);
+	if (urb)
+		atomic64_inc(&ext->tx_urb_alloc);
+	return urb;
+}
+
+static void usbnet_tx_urb_put(struct usbnet *dev, struct urb *urb)
+{
+	struct usbnet_ext *ext = usbnet_ext(dev);
+
+	kfree(urb->sg);
+	urb->sg = NULL;
+	if (atomic_inc_return(&ext->tx_urb_idle) <= TX_QLEN(dev))
+		usb_anchor_urb(urb, &ext->tx_urb_pool);
+	else
+		atomic_dec(&ext->tx_urb_idle);
+	usb_free_urb(urb);
+}
+
+void usbnet_get_ext_stats(struct usbnet *dev, struct usbnet_ext_stats *stats)
+{
+	struct usbnet_ext *ext = usbnet_ext(dev);
+
+	stats->tx_urb_alloc = atomic64_read(&ext->tx_urb_alloc);
+	stats->tx_urb_reuse = atomic64_read(&ext->tx_urb_reuse);
+	stats->tx_queue_stop = atomic64_read(&ext->tx_queue_stop);
+	stats->rx_reserve_used = atomic64_read(&ext->rx_reserve_used);
+	stats->rx_alloc_failed = atomic64_read(&ext->rx_alloc_failed);
+}
+EXPORT_SYMBOL_GPL(usbnet_get_ext_stats);
+
+int usbnet_set_tx_bands(struct usbnet *dev, unsigned int bands,
+			const unsigned int *limit)
+{
+	struct usbnet_ext *ext = usbnet_ext(dev);
+	unsigned int band;
+	int ret;
+
+	if (!bands || bands > USBNET_MAX_TX_BANDS)
+		return -EINVAL;
+
+	ret = netif_set_real_num_tx_queues(dev->net, bands);
+	if (ret < 0)
+		return ret;
+
+	ext->tx_bands = bands;
+	for (band = 0; band < bands; band++)
+		ext->tx_band_limit[band] = limit ? limit[band] : 0;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(usbnet_set_tx_bands);
+
+void usbnet_set_tx_band_limit(struct usbnet *dev, unsigned int band,
+			      unsigned int limit)
+{
+	struct usbnet_ext *ext = usbnet_ext(dev);
+
+	if (band >= ext->tx_bands)
+		return;
+
+	/* a stopped band sees the new limit on the next TX completion */
+	ext->tx_band_limit[band] = limit;
+}
+EXPORT_SYMBOL_GPL(usbnet_set_tx_band_limit);
+
 /*-------------------------------------------------------------------------*/
 
 // randomly generated ethernet address
 static u8	node_id [ETH_ALEN];
 
-static const char driver_name [] = "usbnet";
-
 /* use ethtool to change the level for any given device */
 static int msg_level = -1;
 module_param (msg_level, int, 0);
@@ -125,7 +472,7 @@ int usbnet_get_endpoints(struct usbnet *dev, struct usb_interface *intf)
 				if (!usb_endpoint_dir_in(&e->desc))
 					continue;
 				intr = 1;
-				/* FALLTHROUGH */
+				/* fall through */
 			case USB_ENDPOINT_XFER_BULK:
 				break;
 			default:
@@ -168,10 +515,11 @@ int usbnet_get_ethernet_addr(struct usbnet *dev, int iMACAddress)
 {
 	int 		tmp = -1, ret;
 	unsigned char	buf [13];
+	u8		addr[ETH_ALEN];
 
 	ret = usb_string(dev->udev, iMACAddress, buf, sizeof buf);
 	if (ret == 12)
-		tmp = hex2bin(dev->net->dev_addr, buf, 6);
+		tmp = hex2bin(addr, buf, 6);
 	if (tmp < 0) {
 		dev_dbg(&dev->udev->dev,
 			"bad MAC string %d fetch, %d\n", iMACAddress, tmp);
@@ -179,6 +527,7 @@ int usbnet_get_ethernet_addr(struct usbnet *dev, int iMACAddress)
 			ret = -EINVAL;
 		return ret;
 	}
+	usbnet_set_hw_addr(dev->net, addr);
 	return 0;
 }
 EXPORT_SYMBOL_GPL(usbnet_get_ethernet_addr);
@@ -316,11 +665,8 @@ static void __usbnet_status_stop_force(struct usbnet *dev)
 	}
 }
 
-/* Passes this packet up the stack, updating its accounting.
- * Some link protocols batch packets, so their rx_fixup paths
- * can return clones as well as just modify the original skb.
- */
-void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+static void __usbnet_skb_return(struct usbnet *dev, struct sk_buff *skb,
+				struct napi_struct *napi)
 {
 	int	status;
 
@@ -329,9 +675,11 @@ void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 		return;
 	}
 
-	skb->protocol = eth_type_trans (skb, dev->net);
-	dev->net->stats.rx_packets++;
-	dev->net->stats.rx_bytes += skb->len;
+	/* only update if unset to allow minidriver rx_fixup override */
+	if (skb->protocol == 0)
+		skb->protocol = eth_type_trans (skb, dev->net);
+
+	usbnet_count_stats(dev, false, 1, skb->len);
 
 	netif_dbg(dev, rx_status, dev->net, "< rx, len %zu, type 0x%x\n",
 		  skb->len + sizeof (struct ethhdr), skb->protocol);
@@ -340,11 +688,32 @@ void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 	if (skb_defer_rx_timestamp(skb))
 		return;
 
+	if (napi) {
+		napi_gro_receive(napi, skb);
+		return;
+	}
+
 	status = netif_rx (skb);
 	if (status != NET_RX_SUCCESS)
 		netif_dbg(dev, rx_err, dev->net,
 			  "netif_rx status %d\n", status);
 }
+
+/* Passes this packet up the stack, updating its accounting.
+ * Some link protocols batch packets, so their rx_fixup paths
+ * can return clones as well as just modify the original skb.
+ */
+void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
+{
+	struct usbnet_rx_ctx *ctx = this_cpu_ptr(&usbnet_rx_ctx);
+
+	if (ctx->dev == dev) {
+		ctx->work++;
+		__usbnet_skb_return(dev, skb, ctx->napi);
+	} else {
+		__usbnet_skb_return(dev, skb, NULL);
+	}
+}
 EXPORT_SYMBOL_GPL(usbnet_skb_return);
 
 /* must be called if hard_mtu or rx_urb_size changed */
@@ -356,25 +725,42 @@ void usbnet_update_max_qlen(struct usbnet *dev)
 		goto insanity;
 	switch (speed) {
 	case USB_SPEED_HIGH:
-		dev->rx_qlen = MAX_QUEUE_MEMORY / dev->rx_urb_size;
-		dev->tx_qlen = MAX_QUEUE_MEMORY / dev->hard_mtu;
+		RX_QLEN(dev) = MAX_QUEUE_MEMORY / dev->rx_urb_size;
+		TX_QLEN(dev) = MAX_QUEUE_MEMORY / dev->hard_mtu;
 		break;
 	case USB_SPEED_SUPER:
+#if KERNEL_VERSION(4, 5, 0) <= LINUX_VERSION_CODE
+	case USB_SPEED_SUPER_PLUS:
+#endif
 		/*
 		 * Not take default 5ms qlen for super speed HC to
 		 * save memory, and iperf tests show 2.5ms qlen can
 		 * work well
 		 */
-		dev->rx_qlen = 5 * MAX_QUEUE_MEMORY / dev->rx_urb_size;
-		dev->tx_qlen = 5 * MAX_QUEUE_MEMORY / dev->hard_mtu;
+		RX_QLEN(dev) = 5 * MAX_QUEUE_MEMORY / dev->rx_urb_size;
+		TX_QLEN(dev) = 5 * MAX_QUEUE_MEMORY / dev->hard_mtu;
 		break;
 	default:
 insanity:
-		dev->rx_qlen = dev->tx_qlen = 4;
+		RX_QLEN(dev) = TX_QLEN(dev) = 4;
 	}
 }
 EXPORT_SYMBOL_GPL(usbnet_update_max_qlen);
 
+bool usbnet_enable_dma_sg(struct usbnet *dev)
+{
+	if (usb_device_no_sg_constraint(dev->udev))
+		usbnet_field(dev, can_dma_sg) = 1;
+	return usbnet_field(dev, can_dma_sg);
+}
+EXPORT_SYMBOL_GPL(usbnet_enable_dma_sg);
+
+bool usbnet_can_dma_sg(struct usbnet *dev)
+{
+	return usbnet_field(dev, can_dma_sg);
+}
+EXPORT_SYMBOL_GPL(usbnet_can_dma_sg);
+
 
 /*-------------------------------------------------------------------------
  *
@@ -389,8 +775,10 @@ int usbnet_change_mtu (struct net_device *net, int new_mtu)
 	int		old_hard_mtu = dev->hard_mtu;
 	int		old_rx_urb_size = dev->rx_urb_size;
 
+#if KERNEL_VERSION(4, 10, 0) > LINUX_VERSION_CODE
 	if (new_mtu <= 0)
 		return -EINVAL;
+#endif
 	// no second zero-length packet read wanted after mtu-sized packets
 	if ((ll_mtu % dev->maxpacket) == 0)
 		return -EDOM;
@@ -399,8 +787,11 @@ int usbnet_change_mtu (struct net_device *net, int new_mtu)
 	dev->hard_mtu = net->mtu + net->hard_header_len;
 	if (dev->rx_urb_size == old_hard_mtu) {
 		dev->rx_urb_size = dev->hard_mtu;
-		if (dev->rx_urb_size > old_rx_urb_size)
+		if (dev->rx_urb_size > old_rx_urb_size) {
+			usbnet_pause_rx(dev);
 			usbnet_unlink_rx_urbs(dev);
+			usbnet_resume_rx(dev);
+		}
 	}
 
 	/* max qlen depend on hard_mtu and rx_urb_size */
@@ -426,6 +817,16 @@ static void __usbnet_queue_skb(struct sk_buff_head *list,
  * completion callbacks.  2.5 should have fixed those bugs...
  */
 
+static void usbnet_bh_schedule(struct usbnet *dev)
+{
+	struct usbnet_ext *ext = usbnet_ext(dev);
+
+	if (test_bit(EXT_NAPI_ON, &ext->flags))
+		napi_schedule(&ext->napi);
+	else
+		tasklet_schedule(&dev->bh);
+}
+
 static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 		struct sk_buff_head *list, enum skb_state state)
 {
@@ -446,7 +847,7 @@ static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 
 	__skb_queue_tail(&dev->done, skb);
 	if (dev->done.qlen == 1)
-		tasklet_schedule(&dev->bh);
+		usbnet_bh_schedule(dev);
 	spin_unlock(&dev->done.lock);
 	spin_unlock_irqrestore(&list->lock, flags);
 	return old_state;
@@ -460,12 +861,10 @@ static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 void usbnet_defer_kevent (struct usbnet *dev, int work)
 {
 	set_bit (work, &dev->flags);
-	if (!schedule_work (&dev->kevent)) {
-		if (net_ratelimit())
-			netdev_err(dev->net, "kevent %d may have been dropped\n", work);
-	} else {
+	if (!schedule_work (&dev->kevent))
+		netdev_dbg(dev->net, "kevent %d may have been dropped\n", work);
+	else
 		netdev_dbg(dev->net, "kevent %d scheduled\n", work);
-	}
 }
 EXPORT_SYMBOL_GPL(usbnet_defer_kevent);
 
@@ -473,8 +872,52 @@ EXPORT_SYMBOL_GPL(usbnet_defer_kevent);
 
 static void rx_complete (struct urb *urb);
 
+static struct sk_buff *rx_alloc_skb(struct usbnet *dev, size_t size,
+				    gfp_t flags)
+{
+#ifdef EVENT_NO_IP_ALIGN
+	if (test_bit(EVENT_NO_IP_ALIGN, &dev->flags))
+		return __netdev_alloc_skb(dev->net, size, flags);
+#endif
+	return __netdev_alloc_skb_ip_align(dev->net, size, flags);
+}
+
+/* Aggregating devices need rx_urb_size sized buffers, a smaller one
+ * would split a transfer, so a high order allocation failing in
+ * atomic context is covered by a few buffers kept from keventd.
+ */
+static void rx_reserve_fill(struct usbnet *dev, gfp_t flags)
+{
+	struct sk_buff_head	*reserve = &usbnet_ext(dev)->rx_reserve;
+	struct sk_buff		*skb;
+
+	while (skb_queue_len(reserve) < RX_RESERVE) {
+		skb = rx_alloc_skb(dev, dev->rx_urb_size, flags | __GFP_NOWARN);
+		if (!skb)
+			break;
+		skb_queue_tail(reserve, skb);
+	}
+}
+
+static struct sk_buff *rx_reserve_get(struct usbnet *dev, size_t size)
+{
+	struct usbnet_ext	*ext = usbnet_ext(dev);
+	struct sk_buff		*skb;
+
+	while ((skb = skb_dequeue(&ext->rx_reserve))) {
+		if (skb_tailroom(skb) >= size) {
+			atomic64_inc(&ext->rx_reserve_used);
+			return skb;
+		}
+		/* sized for an rx_urb_size before an MTU change */
+		dev_kfree_skb_any(skb);
+	}
+	return NULL;
+}
+
 static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 {
+	struct usbnet_ext	*ext = usbnet_ext(dev);
 	struct sk_buff		*skb;
 	struct skb_data		*entry;
 	int			retval = 0;
@@ -487,9 +930,20 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 		return -ENOLINK;
 	}
 
-	skb = __netdev_alloc_skb_ip_align(dev->net, size, flags);
+	if (!skb_queue_empty(&ext->rx_reserve))
+		flags |= __GFP_NOWARN;
+	skb = rx_alloc_skb(dev, size, flags);
+	if (!skb) {
+		skb = rx_reserve_get(dev, size);
+		/* this URB is served, keventd only tops the reserve up */
+		if (skb) {
+			set_bit(EXT_RX_REFILL, &ext->flags);
+			schedule_work(&dev->kevent);
+		}
+	}
 	if (!skb) {
 		netif_dbg(dev, rx_err, dev->net, "no rx skb\n");
+		atomic64_inc(&ext->rx_alloc_failed);
 		usbnet_defer_kevent (dev, EVENT_RX_MEMORY);
 		usb_free_urb (urb);
 		return -ENOMEM;
@@ -547,8 +1001,18 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 
 /*-------------------------------------------------------------------------*/
 
-static inline void rx_process (struct usbnet *dev, struct sk_buff *skb)
+// returns the number of frames passed up the stack
+
+static int rx_process(struct usbnet *dev, struct sk_buff *skb,
+		      struct napi_struct *napi)
 {
+	struct usbnet_rx_ctx	*ctx = this_cpu_ptr(&usbnet_rx_ctx);
+	int			work;
+
+	ctx->dev = dev;
+	ctx->napi = napi;
+	ctx->work = 0;
+
 	if (dev->driver_info->rx_fixup &&
 	    !dev->driver_info->rx_fixup (dev, skb)) {
 		/* With RX_ASSEMBLE, rx_fixup() must update counters */
@@ -568,11 +1032,15 @@ static inline void rx_process (struct usbnet *dev, struct sk_buff *skb)
 		netif_dbg(dev, rx_err, dev->net, "rx length %d\n", skb->len);
 	} else {
 		usbnet_skb_return(dev, skb);
-		return;
+		goto out;
 	}
 
 done:
 	skb_queue_tail(&dev->done, skb);
+out:
+	work = ctx->work;
+	ctx->dev = NULL;
+	return work;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -602,7 +1070,7 @@ static void rx_complete (struct urb *urb)
 	case -EPIPE:
 		dev->net->stats.rx_errors++;
 		usbnet_defer_kevent (dev, EVENT_RX_HALT);
-		// FALLTHROUGH
+		/* fall through */
 
 	/* software-driven interface shutdown */
 	case -ECONNRESET:		/* async unlink */
@@ -633,7 +1101,7 @@ block:
 	/* data overrun ... flush fifo? */
 	case -EOVERFLOW:
 		dev->net->stats.rx_over_errors++;
-		// FALLTHROUGH
+		/* fall through */
 
 	default:
 		state = rx_cleanup;
@@ -685,7 +1153,7 @@ void usbnet_resume_rx(struct usbnet *dev)
 	clear_bit(EVENT_RX_PAUSED, &dev->flags);
 
 	while ((skb = skb_dequeue(&dev->rxq_pause)) != NULL) {
-		usbnet_skb_return(dev, skb);
+		__usbnet_skb_return(dev, skb, NULL);
 		num++;
 	}
 
@@ -804,16 +1272,23 @@ static void usbnet_terminate_urbs(struct usbnet *dev)
 int usbnet_stop (struct net_device *net)
 {
 	struct usbnet		*dev = netdev_priv(net);
-	struct driver_info	*info = dev->driver_info;
+	const struct driver_info *info = dev->driver_info;
+	struct rtnl_link_stats64 stats;
 	int			retval, pm, mpn;
 
 	clear_bit(EVENT_DEV_OPEN, &dev->flags);
-	netif_stop_queue (net);
+	netif_tx_stop_all_queues(net);
 
+	/* completions NAPI would have missed go to the tasklet */
+	napi_disable(&usbnet_ext(dev)->napi);
+	clear_bit(EXT_NAPI_ON, &usbnet_ext(dev)->flags);
+	tasklet_schedule(&dev->bh);
+
+	usbnet_fold_stats(dev, &stats);
 	netif_info(dev, ifdown, dev->net,
-		   "stop stats: rx/tx %lu/%lu, errs %lu/%lu\n",
-		   net->stats.rx_packets, net->stats.tx_packets,
-		   net->stats.rx_errors, net->stats.tx_errors);
+		   "stop stats: rx/tx %llu/%llu, errs %llu/%llu\n",
+		   stats.rx_packets, stats.tx_packets,
+		   stats.rx_errors, stats.tx_errors);
 
 	/* to not race resume */
 	pm = usb_autopm_get_interface(dev->intf);
@@ -835,6 +1310,7 @@ int usbnet_stop (struct net_device *net)
 	usbnet_status_stop(dev);
 
 	usbnet_purge_paused_rxq(dev);
+	skb_queue_purge(&usbnet_ext(dev)->rx_reserve);
 
 	mpn = !test_and_clear_bit(EVENT_NO_RUNTIME_PM, &dev->flags);
 
@@ -867,7 +1343,7 @@ int usbnet_open (struct net_device *net)
 {
 	struct usbnet		*dev = netdev_priv(net);
 	int			retval;
-	struct driver_info	*info = dev->driver_info;
+	const struct driver_info *info = dev->driver_info;
 
 	if ((retval = usb_autopm_get_interface(dev->intf)) < 0) {
 		netif_info(dev, ifup, dev->net,
@@ -909,8 +1385,18 @@ int usbnet_open (struct net_device *net)
 		}
 	}
 
+	/* a tasklet or timer still reaping completions would race the
+	 * first poll; NAPI stays disabled until both are quiet, and the
+	 * tasklet_schedule() below picks up whatever they left behind
+	 */
+	tasklet_disable(&dev->bh);
+	set_bit(EXT_NAPI_ON, &usbnet_ext(dev)->flags);
+	del_timer_sync(&dev->delay);
+	napi_enable(&usbnet_ext(dev)->napi);
+	tasklet_enable(&dev->bh);
+
 	set_bit(EVENT_DEV_OPEN, &dev->flags);
-	netif_start_queue (net);
+	netif_tx_start_all_queues(net);
 	netif_info(dev, ifup, dev->net,
 		   "open: enable queueing (rx %d, tx %d) mtu %d %s framing\n",
 		   (int)RX_QLEN(dev), (int)TX_QLEN(dev),
@@ -927,6 +1413,8 @@ int usbnet_open (struct net_device *net)
 	dev->pkt_err = 0;
 	clear_bit(EVENT_RX_KILL, &dev->flags);
 
+	rx_reserve_fill(dev, GFP_KERNEL);
+
 	// delay posting reads until we're fully open
 	tasklet_schedule (&dev->bh);
 	if (info->manage_power) {
@@ -952,6 +1440,43 @@ EXPORT_SYMBOL_GPL(usbnet_open);
  * they'll probably want to use this base set.
  */
 
+#if KERNEL_VERSION(4, 10, 0) <= LINUX_VERSION_CODE
+int usbnet_get_link_ksettings(struct net_device *net,
+			      struct ethtool_link_ksettings *cmd)
+{
+	struct usbnet *dev = netdev_priv(net);
+
+	if (!dev->mii.mdio_read)
+		return -EOPNOTSUPP;
+
+	mii_ethtool_get_link_ksettings(&dev->mii, cmd);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(usbnet_get_link_ksettings);
+
+int usbnet_set_link_ksettings(struct net_device *net,
+			      const struct ethtool_link_ksettings *cmd)
+{
+	struct usbnet *dev = netdev_priv(net);
+	int retval;
+
+	if (!dev->mii.mdio_write)
+		return -EOPNOTSUPP;
+
+	retval = mii_ethtool_set_link_ksettings(&dev->mii, cmd);
+
+	/* link speed/duplex might have changed */
+	if (dev->driver_info->link_reset)
+		dev->driver_info->link_reset(dev);
+
+	/* hard_mtu or rx_urb_size may change in link_reset() */
+	usbnet_update_max_qlen(dev);
+
+	return retval;
+}
+EXPORT_SYMBOL_GPL(usbnet_set_link_ksettings);
+#else
 int usbnet_get_settings (struct net_device *net, struct ethtool_cmd *cmd)
 {
 	struct usbnet *dev = netdev_priv(net);
@@ -981,9 +1506,24 @@ int usbnet_set_settings (struct net_device *net, struct ethtool_cmd *cmd)
 	usbnet_update_max_qlen(dev);
 
 	return retval;
-
 }
 EXPORT_SYMBOL_GPL(usbnet_set_settings);
+#endif
+
+#if KERNEL_VERSION(4, 11, 0) <= LINUX_VERSION_CODE
+void usbnet_get_stats64(struct net_device *net, struct rtnl_link_stats64 *stats)
+{
+	usbnet_fold_stats(netdev_priv(net), stats);
+}
+#else
+struct rtnl_link_stats64 *usbnet_get_stats64(struct net_device *net,
+					     struct rtnl_link_stats64 *stats)
+{
+	usbnet_fold_stats(netdev_priv(net), stats);
+	return stats;
+}
+#endif
+EXPORT_SYMBOL_GPL(usbnet_get_stats64);
 
 u32 usbnet_get_link (struct net_device *net)
 {
@@ -1017,10 +1557,9 @@ void usbnet_get_drvinfo (struct net_device *net, struct ethtool_drvinfo *info)
 {
 	struct usbnet *dev = netdev_priv(net);
 
-	strlcpy (info->driver, dev->driver_name, sizeof info->driver);
-	strlcpy (info->version, DRIVER_VERSION, sizeof info->version);
-	strlcpy (info->fw_version, dev->driver_info->description,
-		sizeof info->fw_version);
+	strscpy(info->driver, dev->driver_name, sizeof(info->driver));
+	strscpy(info->fw_version, dev->driver_info->description,
+		sizeof(info->fw_version));
 	usb_make_path (dev->udev, info->bus_info, sizeof info->bus_info);
 }
 EXPORT_SYMBOL_GPL(usbnet_get_drvinfo);
@@ -1043,14 +1582,19 @@ EXPORT_SYMBOL_GPL(usbnet_set_msglevel);
 
 /* drivers may override default ethtool_ops in their bind() routine */
 static const struct ethtool_ops usbnet_ethtool_ops = {
-	.get_settings		= usbnet_get_settings,
-	.set_settings		= usbnet_set_settings,
 	.get_link		= usbnet_get_link,
 	.nway_reset		= usbnet_nway_reset,
 	.get_drvinfo		= usbnet_get_drvinfo,
 	.get_msglevel		= usbnet_get_msglevel,
 	.set_msglevel		= usbnet_set_msglevel,
 	.get_ts_info		= ethtool_op_get_ts_info,
+#if KERNEL_VERSION(4, 10, 0) <= LINUX_VERSION_CODE
+	.get_link_ksettings	= usbnet_get_link_ksettings,
+	.set_link_ksettings	= usbnet_set_link_ksettings,
+#else
+	.get_settings		= usbnet_get_settings,
+	.set_settings		= usbnet_set_settings,
+#endif
 };
 
 /*-------------------------------------------------------------------------*/
@@ -1079,12 +1623,14 @@ static void __handle_link_change(struct usbnet *dev)
 	clear_bit(EVENT_LINK_CHANGE, &dev->flags);
 }
 
-static void usbnet_set_rx_mode(struct net_device *net)
+#ifdef EVENT_SET_RX_MODE
+void usbnet_set_rx_mode(struct net_device *net)
 {
 	struct usbnet		*dev = netdev_priv(net);
 
 	usbnet_defer_kevent(dev, EVENT_SET_RX_MODE);
 }
+EXPORT_SYMBOL_GPL(usbnet_set_rx_mode);
 
 static void __handle_set_rx_mode(struct usbnet *dev)
 {
@@ -1093,6 +1639,7 @@ static void __handle_set_rx_mode(struct usbnet *dev)
 
 	clear_bit(EVENT_SET_RX_MODE, &dev->flags);
 }
+#endif
 
 /* work that cannot be done in interrupt context uses keventd.
  *
@@ -1124,7 +1671,7 @@ fail_pipe:
 		} else {
 			clear_bit (EVENT_TX_HALT, &dev->flags);
 			if (status != -ESHUTDOWN)
-				netif_wake_queue (dev->net);
+				netif_tx_wake_all_queues(dev->net);
 		}
 	}
 	if (test_bit (EVENT_RX_HALT, &dev->flags)) {
@@ -1147,15 +1694,21 @@ fail_halt:
 		}
 	}
 
+	if (test_and_clear_bit(EXT_RX_REFILL, &usbnet_ext(dev)->flags) &&
+	    netif_running(dev->net))
+		rx_reserve_fill(dev, GFP_KERNEL);
+
 	/* tasklet could resubmit itself forever if memory is tight */
 	if (test_bit (EVENT_RX_MEMORY, &dev->flags)) {
 		struct urb	*urb = NULL;
 		int resched = 1;
 
-		if (netif_running (dev->net))
+		if (netif_running (dev->net)) {
+			rx_reserve_fill(dev, GFP_KERNEL);
 			urb = usb_alloc_urb (0, GFP_KERNEL);
-		else
+		} else {
 			clear_bit (EVENT_RX_MEMORY, &dev->flags);
+		}
 		if (urb != NULL) {
 			clear_bit (EVENT_RX_MEMORY, &dev->flags);
 			status = usb_autopm_get_interface(dev->intf);
@@ -1173,7 +1726,7 @@ fail_lowmem:
 	}
 
 	if (test_bit (EVENT_LINK_RESET, &dev->flags)) {
-		struct driver_info	*info = dev->driver_info;
+		const struct driver_info *info = dev->driver_info;
 		int			retval = 0;
 
 		clear_bit (EVENT_LINK_RESET, &dev->flags);
@@ -1199,8 +1752,10 @@ skip_reset:
 	if (test_bit (EVENT_LINK_CHANGE, &dev->flags))
 		__handle_link_change(dev);
 
+#ifdef EVENT_SET_RX_MODE
 	if (test_bit (EVENT_SET_RX_MODE, &dev->flags))
 		__handle_set_rx_mode(dev);
+#endif
 
 
 	if (dev->flags)
@@ -1214,10 +1769,18 @@ static void tx_complete (struct urb *urb)
 	struct sk_buff		*skb = (struct sk_buff *) urb->context;
 	struct skb_data		*entry = (struct skb_data *) skb->cb;
 	struct usbnet		*dev = entry->dev;
-
-	if (urb->status == 0) {
-		dev->net->stats.tx_packets += entry->packets;
-		dev->net->stats.tx_bytes += entry->length;
+	int			status = urb->status;
+
+	if (status == 0) {
+#if KERNEL_VERSION(3, 16, 0) <= LINUX_VERSION_CODE
+		usbnet_count_stats(dev, true, entry->packets, entry->length);
+#else
+		/* skb_data has no packet count before 3.16 */
+		usbnet_count_stats(dev, true,
+				   !(dev->driver_info->flags &
+				     FLAG_MULTI_PACKET),
+				   entry->length);
+#endif
 	} else {
 		dev->net->stats.tx_errors++;
 
@@ -1244,7 +1807,7 @@ static void tx_complete (struct urb *urb)
 				netif_dbg(dev, link, dev->net,
 					  "tx throttle %d\n", urb->status);
 			}
-			netif_stop_queue (dev->net);
+			netif_tx_stop_all_queues(dev->net);
 			break;
 		default:
 			netif_dbg(dev, tx_err, dev->net,
@@ -1253,58 +1816,88 @@ static void tx_complete (struct urb *urb)
 		}
 	}
 
+	usbnet_tx_band_add(dev, skb, -urb->transfer_buffer_length);
 	usb_autopm_put_interface_async(dev->intf);
 	(void) defer_bh(dev, skb, &dev->txq, tx_done);
+
+	/* restart a stopped band here rather than a tasklet run later,
+	 * so the bulk-out pipe does not drain while packets wait.
+	 */
+	if (status == 0 && test_bit(EVENT_DEV_OPEN, &dev->flags) &&
+	    !test_bit(EVENT_TX_HALT, &dev->flags) &&
+	    !timer_pending(&dev->delay))
+		usbnet_tx_wake(dev);
 }
 
 /*-------------------------------------------------------------------------*/
 
+#if KERNEL_VERSION(5, 6, 0) <= LINUX_VERSION_CODE
+void usbnet_tx_timeout (struct net_device *net, unsigned int txqueue)
+#else
 void usbnet_tx_timeout (struct net_device *net)
+#endif
 {
 	struct usbnet		*dev = netdev_priv(net);
 
 	unlink_urbs (dev, &dev->txq);
 	tasklet_schedule (&dev->bh);
+#if KERNEL_VERSION(4, 4, 0) <= LINUX_VERSION_CODE
 	/* this needs to be handled individually because the generic layer
 	 * doesn't know what is sufficient and could not restore private
 	 * information if a remedy of an unconditional reset were used.
 	 */
 	if (dev->driver_info->recover)
 		(dev->driver_info->recover)(dev);
+#endif
 }
 EXPORT_SYMBOL_GPL(usbnet_tx_timeout);
 
 /*-------------------------------------------------------------------------*/
 
-static int build_dma_sg(const struct sk_buff *skb, struct urb *urb)
+static int sg_add_skb(struct scatterlist *sg, const struct sk_buff *skb)
 {
-	unsigned num_sgs, total_len = 0;
 	int i, s = 0;
 
+	sg_set_buf(&sg[s++], skb->data, skb_headlen(skb));
+
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
+		skb_frag_t *f = &skb_shinfo(skb)->frags[i];
+
+		sg_set_page(&sg[s++], skb_frag_page(f), skb_frag_size(f),
+			    skb_frag_off(f));
+	}
+
+	return s;
+}
+
+/* frag_list members, as a minidriver batching several frames into one
+ * transfer chains them, follow the head's own fragments
+ */
+static int build_dma_sg(const struct sk_buff *skb, struct urb *urb)
+{
+	const struct sk_buff *frag;
+	unsigned num_sgs;
+	int s;
+
 	num_sgs = skb_shinfo(skb)->nr_frags + 1;
+	skb_walk_frags(skb, frag)
+		num_sgs += skb_shinfo(frag)->nr_frags + 1;
 	if (num_sgs == 1)
 		return 0;
 
 	/* reserve one for zero packet */
-	urb->sg = kmalloc((num_sgs + 1) * sizeof(struct scatterlist),
-			  GFP_ATOMIC);
+	urb->sg = kmalloc_array(num_sgs + 1, sizeof(struct scatterlist),
+				GFP_ATOMIC);
 	if (!urb->sg)
 		return -ENOMEM;
 
 	urb->num_sgs = num_sgs;
 	sg_init_table(urb->sg, urb->num_sgs + 1);
 
-	sg_set_buf(&urb->sg[s++], skb->data, skb_headlen(skb));
-	total_len += skb_headlen(skb);
-
-	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
-		struct skb_frag_struct *f = &skb_shinfo(skb)->frags[i];
-
-		total_len += skb_frag_size(f);
-		sg_set_page(&urb->sg[i + s], f->page.p, f->size,
-				f->page_offset);
-	}
-	urb->transfer_buffer_length = total_len;
+	s = sg_add_skb(urb->sg, skb);
+	skb_walk_frags(skb, frag)
+		s += sg_add_skb(&urb->sg[s], frag);
+	urb->transfer_buffer_length = skb->len;
 
 	return 1;
 }
@@ -1316,12 +1909,15 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	unsigned int			length;
 	struct urb		*urb = NULL;
 	struct skb_data		*entry;
-	struct driver_info	*info = dev->driver_info;
+	const struct driver_info *info = dev->driver_info;
 	unsigned long		flags;
 	int retval;
+	u16			band = 0;
 
-	if (skb)
+	if (skb) {
 		skb_tx_timestamp(skb);
+		band = skb_get_queue_mapping(skb);
+	}
 
 	// some devices want funky USB-level framing, for
 	// win32 driver (usually) and/or hardware quirks
@@ -1334,9 +1930,10 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 			netif_dbg(dev, tx_err, dev->net, "can't tx_fixup skb\n");
 			goto drop;
 		}
+		skb_set_queue_mapping(skb, band);
 	}
 
-	if (!(urb = usb_alloc_urb (0, GFP_ATOMIC))) {
+	if (!(urb = usbnet_tx_urb_get(dev))) {
 		netif_dbg(dev, tx_err, dev->net, "no urb\n");
 		goto drop;
 	}
@@ -1347,7 +1944,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 
 	usb_fill_bulk_urb (urb, dev->udev, dev->out,
 			skb->data, skb->len, tx_complete, skb);
-	if (dev->can_dma_sg) {
+	if (usbnet_field(dev, can_dma_sg)) {
 		if (build_dma_sg(skb, urb) < 0)
 			goto drop;
 	}
@@ -1369,13 +1966,15 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 					__skb_put(skb, 1);
 				} else if (urb->num_sgs)
 					sg_set_buf(&urb->sg[urb->num_sgs++],
-							dev->padding_pkt, 1);
+						usbnet_field(dev, padding_pkt),
+						1);
 			}
 		} else
 			urb->transfer_flags |= URB_ZERO_PACKET;
 	}
 	urb->transfer_buffer_length = length;
 
+#if KERNEL_VERSION(3, 16, 0) <= LINUX_VERSION_CODE
 	if (info->flags & FLAG_MULTI_PACKET) {
 		/* Driver has set number of packets and a length delta.
 		 * Calculate the complete length and ensure that it's
@@ -1387,6 +1986,9 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	} else {
 		usbnet_set_skb_tx_stats(skb, 1, length);
 	}
+#else
+	entry->length = length;
+#endif
 
 	spin_lock_irqsave(&dev->txq.lock, flags);
 	retval = usb_autopm_get_interface_async(dev->intf);
@@ -1394,7 +1996,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 		spin_unlock_irqrestore(&dev->txq.lock, flags);
 		goto drop;
 	}
-	if (netif_queue_stopped(net)) {
+	if (__netif_subqueue_stopped(net, band)) {
 		usb_autopm_put_interface_async(dev->intf);
 		spin_unlock_irqrestore(&dev->txq.lock, flags);
 		goto drop;
@@ -1406,7 +2008,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 		/* transmission will be done in resume */
 		usb_anchor_urb(urb, &dev->deferred);
 		/* no use to process more packets */
-		netif_stop_queue(net);
+		netif_tx_stop_all_queues(net);
 		usb_put_urb(urb);
 		spin_unlock_irqrestore(&dev->txq.lock, flags);
 		netdev_dbg(dev->net, "Delaying transmission for resumption\n");
@@ -1416,7 +2018,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 
 	switch ((retval = usb_submit_urb (urb, GFP_ATOMIC))) {
 	case -EPIPE:
-		netif_stop_queue (net);
+		netif_tx_stop_all_queues(net);
 		usbnet_defer_kevent (dev, EVENT_TX_HALT);
 		usb_autopm_put_interface_async(dev->intf);
 		break;
@@ -1426,24 +2028,25 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 			  "tx: submit urb err %d\n", retval);
 		break;
 	case 0:
-		net->trans_start = jiffies;
+		netif_trans_update(net);
 		__usbnet_queue_skb(&dev->txq, skb, tx_start);
-		if (dev->txq.qlen >= TX_QLEN (dev))
-			netif_stop_queue (net);
+		usbnet_tx_band_add(dev, skb, urb->transfer_buffer_length);
+		if (usbnet_tx_band_full(dev, band)) {
+			netif_stop_subqueue(net, band);
+			atomic64_inc(&usbnet_ext(dev)->tx_queue_stop);
+		}
 	}
 	spin_unlock_irqrestore (&dev->txq.lock, flags);
 
 	if (retval) {
 		netif_dbg(dev, tx_err, dev->net, "drop, code %d\n", retval);
 drop:
-		dev->net->stats.tx_dropped++;
+		usbnet_count_dropped(dev, true);
 not_drop:
 		if (skb)
 			dev_kfree_skb_any (skb);
-		if (urb) {
-			kfree(urb->sg);
-			usb_free_urb(urb);
-		}
+		if (urb)
+			usbnet_tx_urb_put(dev, urb);
 	} else
 		netif_dbg(dev, tx_queued, dev->net,
 			  "> tx, len %u, type 0x%x\n", length, skb->protocol);
@@ -1478,23 +2081,28 @@ err:
 
 /*-------------------------------------------------------------------------*/
 
-// tasklet (work deferred from completions, in_irq) or timer
+// work deferred from completions, in_irq: NAPI while open, else tasklet.
+// budget counts the frames passed up the stack.
 
-static void usbnet_bh (unsigned long param)
+static int usbnet_bh_work(struct usbnet *dev, struct napi_struct *napi,
+			  int budget)
 {
-	struct usbnet		*dev = (struct usbnet *) param;
 	struct sk_buff		*skb;
 	struct skb_data		*entry;
+	int			work = 0;
 
-	while ((skb = skb_dequeue (&dev->done))) {
+	while (work < budget &&
+	       (skb = skb_dequeue (&dev->done))) {
 		entry = (struct skb_data *) skb->cb;
 		switch (entry->state) {
 		case rx_done:
 			entry->state = rx_cleanup;
-			rx_process (dev, skb);
+			work += rx_process(dev, skb, napi);
 			continue;
 		case tx_done:
-			kfree(entry->urb->sg);
+			usbnet_tx_urb_put(dev, entry->urb);
+			dev_kfree_skb (skb);
+			continue;
 		case rx_cleanup:
 			usb_free_urb (entry->urb);
 			dev_kfree_skb (skb);
@@ -1504,6 +2112,10 @@ static void usbnet_bh (unsigned long param)
 		}
 	}
 
+	/* more left, NAPI polls again */
+	if (work >= budget)
+		return budget;
+
 	/* restart RX again after disabling due to high error rate */
 	clear_bit(EVENT_RX_KILL, &dev->flags);
 
@@ -1518,13 +2130,14 @@ static void usbnet_bh (unsigned long param)
 	} else if (netif_running (dev->net) &&
 		   netif_device_present (dev->net) &&
 		   netif_carrier_ok(dev->net) &&
-		   !timer_pending (&dev->delay) &&
-		   !test_bit (EVENT_RX_HALT, &dev->flags)) {
+		   !timer_pending(&dev->delay) &&
+		   !test_bit(EVENT_RX_PAUSED, &dev->flags) &&
+		   !test_bit(EVENT_RX_HALT, &dev->flags)) {
 		int	temp = dev->rxq.qlen;
 
 		if (temp < RX_QLEN(dev)) {
 			if (rx_alloc_submit(dev, GFP_ATOMIC) == -ENOLINK)
-				return;
+				return work;
 			if (temp != dev->rxq.qlen)
 				netif_dbg(dev, link, dev->net,
 					  "rxqlen %d --> %d\n",
@@ -1532,10 +2145,66 @@ static void usbnet_bh (unsigned long param)
 			if (dev->rxq.qlen < RX_QLEN(dev))
 				tasklet_schedule (&dev->bh);
 		}
-		if (dev->txq.qlen < TX_QLEN (dev))
-			netif_wake_queue (dev->net);
+		usbnet_tx_wake(dev);
+	}
+
+	return work;
+}
+
+/* Runs from net_rx_action() or, for busy polling sockets, from the
+ * reading thread. Either way only URBs the HCD already gave back are
+ * reaped, the bulk-in pipe itself cannot be polled.
+ */
+static int usbnet_poll(struct napi_struct *napi, int budget)
+{
+	struct usbnet_ext	*ext = container_of(napi, struct usbnet_ext,
+						    napi);
+	struct usbnet		*dev = &ext->dev;
+	int			work;
+
+	work = usbnet_bh_work(dev, napi, budget);
+
+	if (work < budget) {
+#if KERNEL_VERSION(3, 19, 0) <= LINUX_VERSION_CODE
+		napi_complete_done(napi, work);
+#else
+		napi_complete(napi);
+#endif
+		/* defer_bh() only schedules when done was empty */
+		if (!skb_queue_empty(&dev->done))
+			napi_schedule(napi);
 	}
+
+	return work;
+}
+
+// tasklet or timer
+
+#if KERNEL_VERSION(4, 15, 0) <= LINUX_VERSION_CODE
+static void usbnet_bh (struct timer_list *t)
+{
+	struct usbnet		*dev = from_timer(dev, t, delay);
+#else
+static void usbnet_bh (unsigned long param)
+{
+	struct usbnet		*dev = (struct usbnet *) param;
+#endif
+	struct usbnet_ext	*ext = usbnet_ext(dev);
+
+	if (test_bit(EXT_NAPI_ON, &ext->flags))
+		napi_schedule(&ext->napi);
+	else
+		usbnet_bh_work(dev, NULL, INT_MAX);
+}
+
+#if KERNEL_VERSION(4, 15, 0) <= LINUX_VERSION_CODE
+static void usbnet_bh_tasklet(unsigned long data)
+{
+	struct timer_list *t = (struct timer_list *)data;
+
+	usbnet_bh(t);
 }
+#endif
 
 
 /*-------------------------------------------------------------------------
@@ -1570,14 +2239,17 @@ void usbnet_disconnect (struct usb_interface *intf)
 	cancel_work_sync(&dev->kevent);
 
 	usb_scuttle_anchored_urbs(&dev->deferred);
+	usb_scuttle_anchored_urbs(&usbnet_ext(dev)->tx_urb_pool);
+	skb_queue_purge(&usbnet_ext(dev)->rx_reserve);
 
 	if (dev->driver_info->unbind)
 		dev->driver_info->unbind (dev, intf);
 
 	usb_kill_urb(dev->interrupt);
 	usb_free_urb(dev->interrupt);
-	kfree(dev->padding_pkt);
+	kfree(usbnet_field(dev, padding_pkt));
 
+	free_percpu(usbnet_ext(dev)->stats);
 	free_netdev(net);
 }
 EXPORT_SYMBOL_GPL(usbnet_disconnect);
@@ -1587,8 +2259,11 @@ static const struct net_device_ops usbnet_netdev_ops = {
 	.ndo_stop		= usbnet_stop,
 	.ndo_start_xmit		= usbnet_start_xmit,
 	.ndo_tx_timeout		= usbnet_tx_timeout,
+#ifdef EVENT_SET_RX_MODE
 	.ndo_set_rx_mode	= usbnet_set_rx_mode,
+#endif
 	.ndo_change_mtu		= usbnet_change_mtu,
+	.ndo_get_stats64	= usbnet_get_stats64,
 	.ndo_set_mac_address 	= eth_mac_addr,
 	.ndo_validate_addr	= eth_validate_addr,
 };
@@ -1611,11 +2286,14 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	struct usbnet			*dev;
 	struct net_device		*net;
 	struct usb_host_interface	*interface;
-	struct driver_info		*info;
+	const struct driver_info	*info;
 	struct usb_device		*xdev;
 	int				status;
 	const char			*name;
 	struct usb_driver 	*driver = to_usb_driver(udev->dev.driver);
+#if KERNEL_VERSION(3, 13, 0) <= LINUX_VERSION_CODE
+	int				cpu;
+#endif
 
 	/* usbnet already took usb runtime pm, so have to enable the feature
 	 * for usb interface, otherwise usb_autopm_get_interface may return
@@ -1627,7 +2305,7 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	}
 
 	name = udev->dev.driver->name;
-	info = (struct driver_info *) prod->driver_info;
+	info = (const struct driver_info *) prod->driver_info;
 	if (!info) {
 		dev_dbg (&udev->dev, "blacklisted by %s\n", name);
 		return -ENODEV;
@@ -1638,7 +2316,8 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	status = -ENOMEM;
 
 	// set up our own records
-	net = alloc_etherdev(sizeof(*dev));
+	net = alloc_etherdev_mqs(sizeof(struct usbnet_ext),
+				 USBNET_MAX_TX_BANDS, 1);
 	if (!net)
 		goto out;
 
@@ -1650,6 +2329,21 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	dev->intf = udev;
 	dev->driver_info = info;
 	dev->driver_name = name;
+
+	usbnet_ext(dev)->tx_bands = 1;
+	init_usb_anchor(&usbnet_ext(dev)->tx_urb_pool);
+	skb_queue_head_init(&usbnet_ext(dev)->rx_reserve);
+	netif_set_real_num_tx_queues(net, 1);
+
+	usbnet_ext(dev)->stats = alloc_percpu(struct usbnet_pcpu_stats);
+	if (!usbnet_ext(dev)->stats)
+		goto out0;
+#if KERNEL_VERSION(3, 13, 0) <= LINUX_VERSION_CODE
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(usbnet_ext(dev)->stats,
+					    cpu)->syncp);
+#endif
+
 	dev->msg_enable = netif_msg_init (msg_level, NETIF_MSG_DRV
 				| NETIF_MSG_PROBE | NETIF_MSG_LINK);
 	init_waitqueue_head(&dev->wait);
@@ -1657,25 +2351,44 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	skb_queue_head_init (&dev->txq);
 	skb_queue_head_init (&dev->done);
 	skb_queue_head_init(&dev->rxq_pause);
+#if KERNEL_VERSION(4, 15, 0) <= LINUX_VERSION_CODE
+	dev->bh.func = usbnet_bh_tasklet;
+	dev->bh.data = (unsigned long)&dev->delay;
+#else
 	dev->bh.func = usbnet_bh;
 	dev->bh.data = (unsigned long) dev;
+#endif
 	INIT_WORK (&dev->kevent, usbnet_deferred_kevent);
 	init_usb_anchor(&dev->deferred);
+#if KERNEL_VERSION(4, 15, 0) <= LINUX_VERSION_CODE
+	timer_setup(&dev->delay, usbnet_bh, 0);
+#else
 	dev->delay.function = usbnet_bh;
 	dev->delay.data = (unsigned long) dev;
 	init_timer (&dev->delay);
+#endif
 	mutex_init (&dev->phy_mutex);
 	mutex_init(&dev->interrupt_mutex);
 	dev->interrupt_count = 0;
 
 	dev->net = net;
+#if KERNEL_VERSION(6, 1, 0) <= LINUX_VERSION_CODE
+	netif_napi_add(net, &usbnet_ext(dev)->napi, usbnet_poll);
+#else
+	netif_napi_add(net, &usbnet_ext(dev)->napi, usbnet_poll,
+		       NAPI_POLL_WEIGHT);
+#endif
 	strcpy (net->name, "usb%d");
-	memcpy (net->dev_addr, node_id, sizeof node_id);
+	usbnet_set_hw_addr(net, node_id);
 
 	/* rx and tx sides can use different message sizes;
 	 * bind() should set rx_urb_size in that case.
 	 */
 	dev->hard_mtu = net->mtu + net->hard_header_len;
+#if KERNEL_VERSION(4, 10, 0) <= LINUX_VERSION_CODE
+	net->min_mtu = 0;
+	net->max_mtu = ETH_MAX_MTU;
+#endif
 
 	net->netdev_ops = &usbnet_netdev_ops;
 	net->watchdog_timeo = TX_TIMEOUT_JIFFIES;
@@ -1748,10 +2461,10 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	/* initialize max rx_qlen and tx_qlen */
 	usbnet_update_max_qlen(dev);
 
-	if (dev->can_dma_sg && !(info->flags & FLAG_SEND_ZLP) &&
+	if (usbnet_field(dev, can_dma_sg) && !(info->flags & FLAG_SEND_ZLP) &&
 		!(info->flags & FLAG_MULTI_PACKET)) {
-		dev->padding_pkt = kzalloc(1, GFP_KERNEL);
-		if (!dev->padding_pkt) {
+		usbnet_field(dev, padding_pkt) = kzalloc(1, GFP_KERNEL);
+		if (!usbnet_field(dev, padding_pkt)) {
 			status = -ENOMEM;
 			goto out4;
 		}
@@ -1778,7 +2491,7 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	return 0;
 
 out5:
-	kfree(dev->padding_pkt);
+	kfree(usbnet_field(dev, padding_pkt));
 out4:
 	usb_free_urb(dev->interrupt);
 out3:
@@ -1792,6 +2505,8 @@ out1:
 	 */
 	cancel_work_sync(&dev->kevent);
 	del_timer_sync(&dev->delay);
+	free_percpu(usbnet_ext(dev)->stats);
+out0:
 	free_netdev(net);
 out:
 	return status;
@@ -1860,8 +2575,10 @@ int usbnet_resume (struct usb_interface *intf)
 				usb_free_urb(res);
 				usb_autopm_put_interface_async(dev->intf);
 			} else {
-				dev->net->trans_start = jiffies;
+				netif_trans_update(dev->net);
 				__skb_queue_tail(&dev->txq, skb);
+				usbnet_tx_band_add(dev, skb,
+						   res->transfer_buffer_length);
 			}
 		}
 
@@ -1878,8 +2595,7 @@ int usbnet_resume (struct usb_interface *intf)
 				!test_bit(EVENT_RX_HALT, &dev->flags))
 					rx_alloc_submit(dev, GFP_NOIO);
 
-			if (!(dev->txq.qlen >= TX_QLEN(dev)))
-				netif_tx_wake_all_queues(dev->net);
+			usbnet_tx_wake(dev);
 			tasklet_schedule (&dev->bh);
 		}
 	}
@@ -1941,7 +2657,7 @@ static int __usbnet_read_cmd(struct usbnet *dev, u8 cmd, u8 reqtype,
 		   " value=0x%04x index=0x%04x size=%d\n",
 		   cmd, reqtype, value, index, size);
 
-	if (data) {
+	if (size) {
 		buf = kmalloc(size, GFP_KERNEL);
 		if (!buf)
 			goto out;
@@ -1950,8 +2666,13 @@ static int __usbnet_read_cmd(struct usbnet *dev, u8 cmd, u8 reqtype,
 	err = usb_control_msg(dev->udev, usb_rcvctrlpipe(dev->udev, 0),
 			      cmd, reqtype, value, index, buf, size,
 			      USB_CTRL_GET_TIMEOUT);
-	if (err > 0 && err <= size)
-		memcpy(data, buf, err);
+	if (err > 0 && err <= size) {
+        if (data)
+            memcpy(data, buf, err);
+        else
+            netdev_dbg(dev->net,
+                "Huh? Data requested but thrown away.\n");
+    }
 	kfree(buf);
 out:
 	return err;
@@ -1972,7 +2693,13 @@ static int __usbnet_write_cmd(struct usbnet *dev, u8 cmd, u8 reqtype,
 		buf = kmemdup(data, size, GFP_KERNEL);
 		if (!buf)
 			goto out;
-	}
+	} else {
+        if (size) {
+            WARN_ON_ONCE(1);
+            err = -EINVAL;
+            goto out;
+        }
+    }
 
 	err = usb_control_msg(dev->udev, usb_sndctrlpipe(dev->udev, 0),
 			      cmd, reqtype, value, index, buf, size,
@@ -1983,6 +2710,72 @@ out:
 	return err;
 }
 
+/*
+ * The function can't be called inside suspend/resume callback,
+ * otherwise deadlock will be caused.
+ */
+int usbnet_read_cmd(struct usbnet *dev, u8 cmd, u8 reqtype,
+		    u16 value, u16 index, void *data, u16 size)
+{
+	int ret;
+
+	if (usb_autopm_get_interface(dev->intf) < 0)
+		return -ENODEV;
+	ret = __usbnet_read_cmd(dev, cmd, reqtype, value, index,
+				data, size);
+	usb_autopm_put_interface(dev->intf);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(usbnet_read_cmd);
+
+/*
+ * The function can't be called inside suspend/resume callback,
+ * otherwise deadlock will be caused.
+ */
+int usbnet_write_cmd(struct usbnet *dev, u8 cmd, u8 reqtype,
+		     u16 value, u16 index, const void *data, u16 size)
+{
+	int ret;
+
+	if (usb_autopm_get_interface(dev->intf) < 0)
+		return -ENODEV;
+	ret = __usbnet_write_cmd(dev, cmd, reqtype, value, index,
+				 data, size);
+	usb_autopm_put_interface(dev->intf);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(usbnet_write_cmd);
+
+/*
+ * The function can be called inside suspend/resume callback safely
+ * and should only be called by suspend/resume callback generally.
+ */
+int usbnet_read_cmd_nopm(struct usbnet *dev, u8 cmd, u8 reqtype,
+			  u16 value, u16 index, void *data, u16 size)
+{
+	return __usbnet_read_cmd(dev, cmd, reqtype, value, index,
+				 data, size);
+}
+EXPORT_SYMBOL_GPL(usbnet_read_cmd_nopm);
+
+/*
+ * The function can be called inside suspend/resume callback safely
+ * and should only be called by suspend/resume callback generally.
+ */
+int usbnet_write_cmd_nopm(struct usbnet *dev, u8 cmd, u8 reqtype,
+			  u16 value, u16 index, const void *data,
+			  u16 size)
+{
+	return __usbnet_write_cmd(dev, cmd, reqtype, value, index,
+				  data, size);
+}
+EXPORT_SYMBOL_GPL(usbnet_write_cmd_nopm);
+
+/* DSM 4.4 carries the CDC descriptor parser in usbnet, upstream moved
+ * it to the USB core in 4.9
+ */
+#if KERNEL_VERSION(4, 4, 0) <= LINUX_VERSION_CODE && \
+    KERNEL_VERSION(4, 9, 0) > LINUX_VERSION_CODE
 int cdc_parse_cdc_header(struct usb_cdc_parsed_header *hdr,
 				struct usb_interface *intf,
 				u8 *buffer,
@@ -2123,67 +2916,7 @@ next_desc:
 }
 
 EXPORT_SYMBOL(cdc_parse_cdc_header);
-
-/*
- * The function can't be called inside suspend/resume callback,
- * otherwise deadlock will be caused.
- */
-int usbnet_read_cmd(struct usbnet *dev, u8 cmd, u8 reqtype,
-		    u16 value, u16 index, void *data, u16 size)
-{
-	int ret;
-
-	if (usb_autopm_get_interface(dev->intf) < 0)
-		return -ENODEV;
-	ret = __usbnet_read_cmd(dev, cmd, reqtype, value, index,
-				data, size);
-	usb_autopm_put_interface(dev->intf);
-	return ret;
-}
-EXPORT_SYMBOL_GPL(usbnet_read_cmd);
-
-/*
- * The function can't be called inside suspend/resume callback,
- * otherwise deadlock will be caused.
- */
-int usbnet_write_cmd(struct usbnet *dev, u8 cmd, u8 reqtype,
-		     u16 value, u16 index, const void *data, u16 size)
-{
-	int ret;
-
-	if (usb_autopm_get_interface(dev->intf) < 0)
-		return -ENODEV;
-	ret = __usbnet_write_cmd(dev, cmd, reqtype, value, index,
-				 data, size);
-	usb_autopm_put_interface(dev->intf);
-	return ret;
-}
-EXPORT_SYMBOL_GPL(usbnet_write_cmd);
-
-/*
- * The function can be called inside suspend/resume callback safely
- * and should only be called by suspend/resume callback generally.
- */
-int usbnet_read_cmd_nopm(struct usbnet *dev, u8 cmd, u8 reqtype,
-			  u16 value, u16 index, void *data, u16 size)
-{
-	return __usbnet_read_cmd(dev, cmd, reqtype, value, index,
-				 data, size);
-}
-EXPORT_SYMBOL_GPL(usbnet_read_cmd_nopm);
-
-/*
- * The function can be called inside suspend/resume callback safely
- * and should only be called by suspend/resume callback generally.
- */
-int usbnet_write_cmd_nopm(struct usbnet *dev, u8 cmd, u8 reqtype,
-			  u16 value, u16 index, const void *data,
-			  u16 size)
-{
-	return __usbnet_write_cmd(dev, cmd, reqtype, value, index,
-				  data, size);
-}
-EXPORT_SYMBOL_GPL(usbnet_write_cmd_nopm);
+#endif
 
 static void usbnet_async_cmd_cb(struct urb *urb)
 {
@@ -2215,11 +2948,8 @@ int usbnet_write_cmd_async(struct usbnet *dev, u8 cmd, u8 reqtype,
 		   cmd, reqtype, value, index, size);
 
 	urb = usb_alloc_urb(0, GFP_ATOMIC);
-	if (!urb) {
-		netdev_err(dev->net, "Error allocating URB in"
-			   " %s!\n", __func__);
+	if (!urb)
 		goto fail;
-	}
 
 	if (data) {
 		buf = kmemdup(data, size, GFP_ATOMIC);
@@ -2270,7 +3000,7 @@ static int __init usbnet_init(void)
 {
 	/* Compiler should optimize this out. */
 	BUILD_BUG_ON(
-		FIELD_SIZEOF(struct sk_buff, cb) < sizeof(struct skb_data));
+		sizeof_field(struct sk_buff, cb) < sizeof(struct skb_data));
 
 	eth_random_addr(node_id);
 	return 0;
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Interfaces of the bundled usbnet core that the kernel's
+ * <linux/usb/usbnet.h> does not provide.
+ */
+
+#ifndef __LINUX_USB_USBNET_EXT_H
+#define __LINUX_USB_USBNET_EXT_H
+
+#include <linux/types.h>
+#include <linux/version.h>
+
+struct usbnet;
+struct net_device;
+struct rtnl_link_stats64;
+
+#define USBNET_MAX_TX_BANDS	4
+
+/* struct usbnet gains queue sizing in 3.12 and SG TX state in 3.14,
+ * before that the core keeps them privately.
+ */
+#if KERNEL_VERSION(3, 14, 0) > LINUX_VERSION_CODE && \
+    (!defined(RHEL_RELEASE_CODE) || !RHEL_RELEASE_CODE)
+#define USBNET_EXT_LEGACY
+#endif
+
+/* Counters kept by the core, see usbnet_get_ext_stats() */
+struct usbnet_ext_stats {
+	u64	tx_urb_alloc;
+	u64	tx_urb_reuse;
+	u64	tx_queue_stop;
+	u64	rx_reserve_used;
+	u64	rx_alloc_failed;
+};
+
+/* Split TX into bands, one netdev TX queue each. limit[band] caps the
+ * bytes a band may have in flight on the bulk-out pipe, 0 leaves only
+ * the common tx_qlen limit. Call from bind().
+ */
+extern int usbnet_set_tx_bands(struct usbnet *dev, unsigned int bands,
+			       const unsigned int *limit);
+
+/* Change the limit of one band later, e.g. on a link speed change */
+extern void usbnet_set_tx_band_limit(struct usbnet *dev, unsigned int band,
+				     unsigned int limit);
+
+extern void usbnet_get_ext_stats(struct usbnet *dev,
+				 struct usbnet_ext_stats *stats);
+
+/* Count an RX frame the minidriver dropped in rx_fixup() */
+extern void usbnet_rx_dropped(struct usbnet *dev);
+
+/* The kernel header declares it from 4.12 */
+#if KERNEL_VERSION(4, 11, 0) <= LINUX_VERSION_CODE
+extern void usbnet_get_stats64(struct net_device *net,
+			       struct rtnl_link_stats64 *stats);
+#else
+extern struct rtnl_link_stats64 *
+usbnet_get_stats64(struct net_device *net, struct rtnl_link_stats64 *stats);
+#endif
+
+/* Resize rx_qlen/tx_qlen after hard_mtu or rx_urb_size changed */
+extern void usbnet_update_max_qlen(struct usbnet *dev);
+
+/* Let start_xmit() map paged skbs through URB scatter-gather when the
+ * host controller takes any SG layout. Returns whether it is enabled.
+ */
+extern bool usbnet_enable_dma_sg(struct usbnet *dev);
+extern bool usbnet_can_dma_sg(struct usbnet *dev);
+
+#endif /* __LINUX_USB_USBNET_EXT_H */